@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fboo/catalog.hpp"
+#include "fboo/entity.hpp"
+#include "fboo/event.hpp"
+#include "fboo/game.hpp"
+#include "fboo/order.hpp"
+#include "paths.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::chrono::milliseconds min_time{200};
+    Order::Schedule schedule = Order::Schedule::serial;
+    // Json-files of the catalog.
+    std::string item = JSON_ITEM;
+    std::string recipe = JSON_RECIPE;
+    std::string factory = JSON_FACTORY;
+    std::string technology = JSON_TECHNOLOGY;
+    bool bundled = true;  // Whether the bundled catalog is used.
+    // Whether Order and Simulation allocate from a monotonic arena (as fboo
+    // does) instead of the heap.
+    bool arena = false;
+};
+
+// The memory resource for one iteration: an arena, or the heap.
+class Memory {
+public:
+    explicit Memory(const Options &options) {
+        if (options.arena) {
+            arena.emplace();
+        }
+    }
+
+    std::pmr::memory_resource *resource() {
+        return arena ? &*arena : std::pmr::get_default_resource();
+    }
+
+private:
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
+
+catalog::Entities load_json(const Options &options) {
+    return catalog::load_json(options.item, options.recipe, options.factory,
+                              options.technology);
+}
+
+// Run f repeatedly for at least min_time, but at least once. Returns the
+// number of iterations and the mean duration of one iteration.
+template <class F>
+json measure(F &&f, const Options &options) {
+    long iterations = 0;
+    auto start = Clock::now(), now = start;
+    do {
+        f();
+        ++iterations;
+        now = Clock::now();
+    } while (now - start < options.min_time);
+    double ns = std::chrono::duration<double, std::nano>(now - start).count();
+    return {{"iterations", iterations}, {"ns-per-op", ns / iterations}};
+}
+
+double per_second(double count, const json &m) {
+    return count / (m["ns-per-op"].get<double>() * 1e-9);
+}
+
+json bench_catalog(const Options &options) {
+    json results = json::array();
+    auto add = [&](const std::string &name, json m) {
+        m["name"] = name;
+        results.push_back(m);
+    };
+
+    add("load-json", measure([&] { load_json(options); }, options));
+    if (options.bundled && std::filesystem::exists(CATALOG_BIN)) {
+        add("map-binary", measure([] {
+                catalog::Catalog c(CATALOG_BIN);
+                return c.recipes().size();
+            }, options));
+        add("load-binary", measure([] {
+                catalog::Catalog(CATALOG_BIN).to_entities();
+            }, options));
+    }
+
+    auto [items, recipes, factories, technologies] = load_json(options);
+    add("entity-index", measure([&] {
+            EntityIndex index(recipes, factories, technologies);
+        }, options));
+    return results;
+}
+
+// Time Order::compute on the challenge, and simulate the resulting plan.
+json bench_challenge(const catalog::Entities &entities,
+                     const EntityIndex &index,
+                     const std::filesystem::path &path,
+                     const Options &options) {
+    const auto &[items, recipes, factories, technologies] = entities;
+
+    json target;
+    std::ifstream(path) >> target;
+    auto initial_items = target["initial-items"].get<ItemList>();
+    auto goal_items = target["goal-items"].get<ItemList>();
+
+    EventList events;
+    std::unordered_map<FactoryIdMap::fid_t, const Factory *> initial_factories;
+    for (const auto &[_, v] : target["initial-factories"].items()) {
+        initial_factories[v["factory-id"]] = &factories.at(v["factory-type"]);
+        events.push_back(
+            BuildEvent(BuildEvent::initial, factories.at(v["factory-type"]),
+                       v["factory-id"]));
+    }
+
+    EventList plan;
+    json compute = measure([&] {
+        Memory memory(options);
+        Order order(recipes, factories, technologies, index,
+                    initial_factories, initial_items, goal_items,
+                    options.schedule, nullptr, memory.resource());
+        plan = order.compute();
+    }, options);
+    compute["events"] = plan.size();
+    compute["events-per-second"] = per_second(plan.size(), compute);
+
+    std::ranges::copy(plan, std::back_inserter(events));
+    long ticks = 0;
+    json simulate = measure([&] {
+        Memory memory(options);
+        game::Simulation sim(recipes, factories, technologies, events,
+                             initial_items, memory.resource());
+        ticks = sim.simulate();
+    }, options);
+    simulate["events"] = events.size();
+    simulate["ticks"] = ticks;
+    simulate["events-per-second"] = per_second(events.size(), simulate);
+    simulate["ticks-per-second"] = per_second(ticks, simulate);
+
+    return {{"challenge", path.stem().string()},
+            {"compute", compute},
+            {"simulate", simulate}};
+}
+
+// All bundled challenges (sorted by name) and the example challenge.
+std::vector<std::filesystem::path> default_challenges() {
+    std::vector<std::filesystem::path> paths;
+    for (const auto &e : std::filesystem::directory_iterator(JSON_CHALLENGES)) {
+        if (e.path().filename().string().starts_with("challenge-")) {
+            paths.push_back(e.path());
+        }
+    }
+    std::ranges::sort(paths);
+    paths.emplace_back(JSON_EXAMPLE);
+    return paths;
+}
+
+}  // namespace
+
+// Print the timings of catalog loading, planning, and simulation as json.
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    Options options;
+    if (std::erase(args, "--concurrent") > 0) {
+        options.schedule = Order::Schedule::concurrent;
+    }
+    options.arena = std::erase(args, "--arena") > 0;
+    // Remove an option with a value from args and return the value.
+    bool valid = true;
+    auto take_value = [&](const std::string &option) {
+        std::optional<std::string> value;
+        if (auto it = std::ranges::find(args, option); it != args.end()) {
+            if (it + 1 == args.end()) {
+                valid = false;
+                return value;
+            }
+            value = *(it + 1);
+            args.erase(it, it + 2);
+        }
+        return value;
+    };
+    if (auto ms = take_value("--min-time-ms")) {
+        options.min_time = std::chrono::milliseconds(std::stol(*ms));
+    }
+    if (auto dir = take_value("--catalog")) {
+        // E.g., generated by fboo-gen.
+        std::filesystem::path d = *dir;
+        options.item = d / "item.json";
+        options.recipe = d / "recipe.json";
+        options.factory = d / "factory.json";
+        options.technology = d / "technology.json";
+        options.bundled = false;
+    }
+    // The bundled challenges only apply to the bundled catalog.
+    if (!valid || (!options.bundled && args.empty())) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--min-time-ms ms] [--concurrent] [--arena]"
+                     " [target.json]..."
+                  << std::endl
+                  << "       " << argv[0]
+                  << " --catalog directory [--min-time-ms ms] [--concurrent]"
+                     " [--arena] target.json..."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::filesystem::path> challenges(args.begin(), args.end());
+    if (challenges.empty()) {
+        challenges = default_challenges();
+    }
+
+    json result;
+    result["min-time-ms"] = options.min_time.count();
+    result["arena"] = options.arena;
+    result["catalog"] = bench_catalog(options);
+
+    const catalog::Entities entities = load_json(options);
+    const auto &[items, recipes, factories, technologies] = entities;
+    const EntityIndex index(recipes, factories, technologies);
+    result["challenges"] = json::array();
+    for (const auto &path : challenges) {
+        result["challenges"].push_back(
+            bench_challenge(entities, index, path, options));
+    }
+
+    std::cout << result.dump(4) << std::endl;
+}
@@ -0,0 +1,28 @@
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+#include "fboo/catalog.hpp"
+
+// Convert the json-files of the game data into a binary catalog, which fboo
+// maps into memory at startup instead of parsing the json-files. With --cpp,
+// generate the C++ source of the tables compiled into fboo-embedded instead.
+int main(int argc, char *argv[]) {
+    bool cpp = argc > 1 && std::string_view(argv[1]) == "--cpp";
+    if (argc != 6 + cpp) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--cpp] output item.json recipe.json factory.json"
+                     " technology.json"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    char **args = argv + 1 + cpp;
+    if (cpp) {
+        std::ofstream out(args[0], std::ios::trunc);
+        catalog::write_cpp(out, args[1], args[2], args[3], args[4]);
+    } else {
+        std::ofstream out(args[0], std::ios::binary | std::ios::trunc);
+        catalog::write_binary(out, args[1], args[2], args[3], args[4]);
+    }
+}
@@ -1,12 +1,27 @@
+#include <atomic>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "fboo/bom.hpp"
+#include "fboo/cache.hpp"
+#include "fboo/catalog.hpp"
+#include "fboo/cost.hpp"
 #include "fboo/entity.hpp"
 #include "fboo/event.hpp"
 #include "fboo/game.hpp"
+#include "fboo/optimize.hpp"
 #include "fboo/order.hpp"
+#include "fboo/rate.hpp"
+#include "fboo/stats.hpp"
 #include "fboo/util.hpp"
 #include "paths.h"
 
@@ -14,89 +29,87 @@ using json = nlohmann::json;
 
 namespace {
 
-// Read the json-files for each type of entity and construct the appropriate
-// C++-objects for them. Return a tuple containing the unordered maps of all
-// items, recipes, factories, and technologies (in that order).
-auto init_entities() {
-    json item;
-    std::ifstream(JSON_ITEM) >> item;
-    ItemMap items;
-    for (const auto &[name, val] : item.items()) {
-        items.emplace(std::piecewise_construct, std::forward_as_tuple(name),
-                      std::forward_as_tuple(name, val["type"]));
-    }
-
-    //for (const auto& [k, v] : items) { std::clog << v << std::endl; }
-
-    json recipe;
-    std::ifstream(JSON_RECIPE) >> recipe;
-    RecipeMap recipes;
-    for (const auto &[name, val] : recipe.items()) {
-        recipes.emplace(
-            std::piecewise_construct, std::forward_as_tuple(name),
-            std::forward_as_tuple(name, val["category"], val["energy"],
-                                  val["enabled"], val["ingredients"],
-                                  val["products"]));
-    }
-
-    //for (const auto& [k, v] : recipes) { std::clog << v << std::endl; }
-
-    json factory;
-    std::ifstream(JSON_FACTORY) >> factory;
-    FactoryMap factories;
-    for (const auto &[name, val] : factory.items()) {
-        factories.emplace(std::piecewise_construct, std::forward_as_tuple(name),
-                          std::forward_as_tuple(name, val["crafting_speed"],
-                                                val["crafting_categories"]));
-    }
-
-    //for (const auto& [k, v] : factories) { std::clog << v << std::endl; }
-
-    json technology;
-    std::ifstream(JSON_TECHNOLOGY) >> technology;
-    TechnologyMap technologies;
-    for (const auto &[name, val] : technology.items()) {
-        std::vector<std::string> unlocked_recipes;
-        for (const auto &e : val["effects"]) {
-            if (e["type"] != "unlock-recipe") {
-                std::cerr << "invalid field in " << name << ": " << e
-                          << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            unlocked_recipes.push_back(e["recipe"]);
-        }
+#ifdef FBOO_EMBEDDED_CATALOG
+constexpr bool embedded_catalog = true;
+#else
+constexpr bool embedded_catalog = false;
+#endif
 
-        technologies.emplace(
-            std::piecewise_construct, std::forward_as_tuple(name),
-            std::forward_as_tuple(name, val["prerequisites"],
-                                  val["ingredients"], unlocked_recipes));
+#ifdef FBOO_EMBEDDED_CATALOG
+// Hash the tables compiled into fboo-embedded.
+std::uint64_t hash_tables(const catalog::format::Tables &t) {
+    auto bytes = [](auto span) {
+        auto b = std::as_bytes(span);
+        return std::string_view(reinterpret_cast<const char *>(b.data()),
+                                b.size());
+    };
+    std::uint64_t h = PlanCache::hash(t.strings);
+    for (std::string_view b :
+         {bytes(t.items), bytes(t.recipes), bytes(t.factories),
+          bytes(t.technologies), bytes(t.amounts), bytes(t.names)}) {
+        h = PlanCache::hash(b, h);
     }
+    return h;
+}
+#endif
 
-    //for (const auto& [k, v] : technologies) { std::clog << v << std::endl; }
-
-    return std::tuple(items, recipes, factories, technologies);
+// Load all items, recipes, factories, and technologies (in that order). The
+// catalog compiled into fboo-embedded or the binary catalog generated at build
+// time is preferred, since both are much cheaper than parsing the json-files.
+// A directory containing other json-files (e.g., generated by fboo-gen)
+// replaces the bundled ones. A hash identifying the catalog that was actually
+// loaded is stored in *catalog_hash.
+catalog::Entities init_entities(const std::optional<std::filesystem::path> &dir,
+                                std::uint64_t *catalog_hash) {
+    if (dir) {
+        *catalog_hash = catalog::hash_json(
+            *dir / "item.json", *dir / "recipe.json", *dir / "factory.json",
+            *dir / "technology.json");
+        return catalog::load_json(*dir / "item.json", *dir / "recipe.json",
+                                  *dir / "factory.json",
+                                  *dir / "technology.json");
+    }
+#ifdef FBOO_EMBEDDED_CATALOG
+    *catalog_hash = hash_tables(catalog::embedded_tables());
+    return catalog::Catalog(catalog::embedded_tables()).to_entities();
+#else
+    // The binary catalog is outdated if the json-files changed since the last
+    // build.
+    *catalog_hash = catalog::hash_json(JSON_ITEM, JSON_RECIPE, JSON_FACTORY,
+                                       JSON_TECHNOLOGY);
+    try {
+        catalog::Catalog c(CATALOG_BIN);
+        if (c.get_source_hash() == *catalog_hash) {
+            return c.to_entities();
+        }
+    } catch (const std::runtime_error &) {
+        // Missing, truncated, or invalid.
+    }
+    return catalog::load_json(JSON_ITEM, JSON_RECIPE, JSON_FACTORY,
+                              JSON_TECHNOLOGY);
+#endif
 }
 
-[[maybe_unused]] void test_challenge1() {
+[[maybe_unused]] void test_challenge1(const catalog::Entities &entities) {
     json target;
     std::ifstream(JSON_CHALLENGE1) >> target;
 
     auto initial_items = target["initial-items"].get<ItemList>();
     auto goal_items = target["goal-items"].get<ItemList>();
 
+    const auto &[items, recipes, factories, technologies] = entities;
     EventList events;
     for (const auto &[_, v] : target["initial-factories"].items()) {
         events.push_back(
-            std::make_shared<BuildEvent>(BuildEvent::initial, v["factory-type"],
-                                         v["factory-name"], v["factory-id"]));
+            BuildEvent(BuildEvent::initial, factories.at(v["factory-type"]),
+                       v["factory-id"]));
     }
 
-    events.push_back(std::make_shared<StartEvent>(0, 0, "coal"));
-    events.push_back(std::make_shared<StopEvent>(60, 0));
-    events.push_back(std::make_shared<VictoryEvent>(60));
+    events.push_back(StartEvent(0, 0, recipes.at("coal")));
+    events.push_back(StopEvent(60, 0));
+    events.push_back(VictoryEvent(60));
     std::clog << events << std::endl;
 
-    const auto [items, recipes, factories, technologies] = init_entities();
     game::Simulation sim(recipes, factories, technologies, events,
                          initial_items);
     long tick = sim.simulate();
@@ -106,32 +119,30 @@ auto init_entities() {
     }
 }
 
-[[maybe_unused]] void test_challenge2() {
+[[maybe_unused]] void test_challenge2(const catalog::Entities &entities) {
     json target;
     std::ifstream(JSON_CHALLENGE2) >> target;
 
     auto initial_items = target["initial-items"].get<ItemList>();
     auto goal_items = target["goal-items"].get<ItemList>();
 
+    const auto &[items, recipes, factories, technologies] = entities;
     EventList events;
     for (const auto &[_, v] : target["initial-factories"].items()) {
         events.push_back(
-            std::make_shared<BuildEvent>(BuildEvent::initial, v["factory-type"],
-                                         v["factory-name"], v["factory-id"]));
-    }
-
-    events.push_back(std::make_shared<StartEvent>(0, 0, "coal"));
-    events.push_back(std::make_shared<BuildEvent>(60, "burner-mining-drill",
-                                                  "coal-mine", 1));
-    events.push_back(std::make_shared<StartEvent>(60, 1, "coal-burner"));
-    events.push_back(std::make_shared<StartEvent>(60, 0, "iron-ore"));
-    events.push_back(std::make_shared<BuildEvent>(120, "stone-furnace",
-                                                  "iron-smelter", 2));
-    events.push_back(std::make_shared<StartEvent>(120, 2, "iron-plate-burner"));
-    events.push_back(std::make_shared<VictoryEvent>(6600));
+            BuildEvent(BuildEvent::initial, factories.at(v["factory-type"]),
+                       v["factory-id"]));
+    }
+
+    events.push_back(StartEvent(0, 0, recipes.at("coal")));
+    events.push_back(BuildEvent(60, factories.at("burner-mining-drill"), 1));
+    events.push_back(StartEvent(60, 1, recipes.at("coal-burner")));
+    events.push_back(StartEvent(60, 0, recipes.at("iron-ore")));
+    events.push_back(BuildEvent(120, factories.at("stone-furnace"), 2));
+    events.push_back(StartEvent(120, 2, recipes.at("iron-plate-burner")));
+    events.push_back(VictoryEvent(6600));
     std::clog << events << std::endl;
 
-    const auto [items, recipes, factories, technologies] = init_entities();
     game::Simulation sim(recipes, factories, technologies, events,
                          initial_items);
     long tick = sim.simulate();
@@ -141,45 +152,449 @@ auto init_entities() {
     }
 }
 
-}  // namespace
+struct Options {
+    bool run_simulation = false;
+    Order::Schedule schedule = Order::Schedule::serial;
+    // Improve the solution of Order with a PlanOptimizer.
+    std::optional<PlanOptimizer::Options> optimize;
+    // If set, Order tries the cheapest recipes first.
+    const CostModel *costs = nullptr;
+    // If set, solutions are looked up in and added to the cache. The keys
+    // start with cache_prefix, which identifies the catalog and the options
+    // above.
+    const PlanCache *cache = nullptr;
+    std::string cache_prefix;
+};
 
-int main(int argc, char *argv[]) {
-    if (argc != 2 && argc != 3) {
-        std::cerr << "usage: " << argv[0] << " target.json [--run-simulation]"
-                  << std::endl;
-        return EXIT_FAILURE;
-    }
+// Compute a solution for the challenge in target and pass its events to sink.
+// If run_simulation is set, the solution is verified by simulating it before
+// any event is passed on, and the resulting tick is stored in tick. If
+// optimize is set, the solution is improved first. If cache is set, a cached
+// solution is used instead (if it was simulated, as far as required). Only
+// reads the (shared) entities, so it can run concurrently.
+void solve(const catalog::Entities &entities, const EntityIndex &index,
+           const json &target, const Options &options, EventSink &sink,
+           long *tick = nullptr) {
+    const auto &[items, recipes, factories, technologies] = entities;
 
-    std::clog.setstate(std::ios_base::failbit);
-    test_challenge1();
-    test_challenge2();
-    std::clog.clear();
-
-    const auto [items, recipes, factories, technologies] = init_entities();
-
-    json target;
-    std::ifstream(argv[1]) >> target;
     auto initial_items = target["initial-items"].get<ItemList>();
     auto goal_items = target["goal-items"].get<ItemList>();
 
+    std::string cache_key;
+    if (options.cache) {
+        cache_key = options.cache_prefix + PlanCache::challenge_key(target);
+        auto entry = options.cache->find(cache_key, recipes, factories,
+                                         technologies);
+        if (entry && (entry->tick || !options.run_simulation)) {
+            if (tick && entry->tick) {
+                *tick = *entry->tick;
+            }
+            for (const AnyEvent &e : entry->events) {
+                sink.push(e);
+            }
+            return;
+        }
+    }
+
     EventList events;
     std::unordered_map<FactoryIdMap::fid_t, const Factory *> initial_factories;
     for (const auto &[_, v] : target["initial-factories"].items()) {
         initial_factories[v["factory-id"]] = &factories.at(v["factory-type"]);
         events.push_back(
-            std::make_shared<BuildEvent>(BuildEvent::initial, v["factory-type"],
-                                         v["factory-name"], v["factory-id"]));
+            BuildEvent(BuildEvent::initial, factories.at(v["factory-type"]),
+                       v["factory-id"]));
+    }
+
+    // Order and the Simulation allocate from the arena, which releases
+    // everything at once when the challenge is solved.
+    std::pmr::monotonic_buffer_resource arena;
+    Order order(recipes, factories, technologies, index, initial_factories,
+                initial_items, goal_items, options.schedule, options.costs,
+                &arena);
+    if (!options.run_simulation && !options.optimize && !options.cache) {
+        order.compute(sink);
+        return;
     }
 
-    Order order(recipes, factories, technologies, initial_factories,
-                initial_items, goal_items);
     EventList solution_events = order.compute();
-    std::ranges::copy(solution_events, std::back_inserter(events));
-    std::cout << json(solution_events) << std::endl;
+    if (options.optimize) {
+        PlanOptimizer optimizer(recipes, factories, technologies, events,
+                                initial_items, goal_items);
+        solution_events = optimizer.optimize(std::move(solution_events),
+                                             *options.optimize);
+    }
+    std::optional<long> t;
+    if (options.run_simulation) {
+        std::ranges::copy(solution_events, std::back_inserter(events));
+        game::Simulation sim(recipes, factories, technologies,
+                             std::move(events), initial_items, &arena);
+        t = sim.simulate();
+        if (tick) {
+            *tick = *t;
+        }
+    }
+    if (options.cache) {
+        options.cache->store(cache_key, {solution_events, t});
+    }
+    for (const AnyEvent &e : solution_events) {
+        sink.push(e);
+    }
+}
+
+// Yields the initial BuildEvents of a challenge, followed by the events of
+// another source.
+class ReplaySource : public EventSource {
+public:
+    ReplaySource(const json &target, const FactoryMap &factories,
+                 EventSource &events)
+        : events(events) {
+        for (const auto &[_, v] : target["initial-factories"].items()) {
+            initial.push_back(BuildEvent(BuildEvent::initial,
+                                         factories.at(v["factory-type"]),
+                                         v["factory-id"]));
+        }
+    }
+
+    std::optional<AnyEvent> next() override {
+        if (next_initial < initial.size()) {
+            return std::move(initial[next_initial++]);
+        }
+        return events.next();
+    }
+
+private:
+    EventList initial;
+    std::size_t next_initial = 0;
+    EventSource &events;
+};
+
+// Simulate the (time-ordered) events in plan_path for the challenge in target
+// without loading the whole plan into memory. If validate is set, violations
+// are reported instead of thrown, and the goal items must be produced.
+json replay(const catalog::Entities &entities, const json &target,
+            const std::string &plan_path, bool validate) {
+    const auto &[items, recipes, factories, technologies] = entities;
+
+    std::ifstream plan(plan_path);
+    if (!plan) {
+        throw std::runtime_error("cannot open " + plan_path);
+    }
+    EventReader reader(plan, recipes, factories, technologies);
+    ReplaySource source(target, factories, reader);
+    game::Simulation sim(recipes, factories, technologies, source,
+                         target["initial-items"].get<ItemList>());
+    json result;
+    if (!validate) {
+        result["simulated-tick"] = sim.simulate();
+        return result;
+    }
+
+    ItemCount goal_items;
+    for (const auto &[name, amount] : target["goal-items"].get<ItemList>()) {
+        goal_items[name] += amount;
+    }
+    std::optional<game::Violation> violation = sim.validate(goal_items);
+    result["valid"] = !violation;
+    if (violation) {
+        result["violation"] = *violation;
+    }
+    return result;
+}
+
+// Expand directories to the json-files they contain (sorted by name).
+std::vector<std::filesystem::path> collect_challenges(
+    const std::vector<std::string> &args) {
+    std::vector<std::filesystem::path> paths;
+    for (const std::string &arg : args) {
+        if (!std::filesystem::is_directory(arg)) {
+            paths.emplace_back(arg);
+            continue;
+        }
+
+        std::vector<std::filesystem::path> dir;
+        for (const auto &e : std::filesystem::directory_iterator(arg)) {
+            if (e.is_regular_file() && e.path().extension() == ".json") {
+                dir.push_back(e.path());
+            }
+        }
+        std::ranges::sort(dir);
+        std::ranges::copy(dir, std::back_inserter(paths));
+    }
+    return paths;
+}
+
+// Solve all challenges on a pool of threads, which share the entities. Print
+// one json-object per line and challenge, in the order of the input.
+void solve_batch(const catalog::Entities &entities, const EntityIndex &index,
+                 const std::vector<std::filesystem::path> &challenges,
+                 const Options &options) {
+    std::vector<json> results(challenges.size());
+    std::atomic<std::size_t> next = 0;
 
-    if (argc == 3) {
-        game::Simulation sim(recipes, factories, technologies, events,
-                             initial_items);
-        sim.simulate();
+    auto worker = [&] {
+        for (std::size_t i = next++; i < challenges.size(); i = next++) {
+            json &result = results[i];
+            result["challenge"] = challenges[i].string();
+            try {
+                json target;
+                std::ifstream(challenges[i]) >> target;
+                long tick;
+                EventCollector collector;
+                solve(entities, index, target, options, collector, &tick);
+                result["events"] = collector.events;
+                if (options.run_simulation) {
+                    result["simulated-tick"] = tick;
+                }
+            } catch (const std::exception &e) {
+                result["error"] = e.what();
+            }
+        }
+    };
+
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<std::size_t>(jobs, challenges.size());
+    std::vector<std::jthread> pool;
+    for (unsigned i = 1; i < jobs; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    pool.clear();  // Join.
+
+    for (const json &result : results) {
+        std::cout << result << '\n';
+    }
+    std::cout << std::flush;
+}
+
+// Read challenges from stdin, one json-object per line, until EOF, and print
+// one json-object per line and challenge, like solve_batch. The "id" of a
+// request, if any, is copied to its response. The entities stay loaded, and
+// the solutions of repeated challenges are answered from a cache.
+void serve(const catalog::Entities &entities, const EntityIndex &index,
+           const Options &options) {
+    constexpr std::size_t max_cached = 4096;
+    std::unordered_map<std::string, json> cache;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        json result;
+        try {
+            json target = json::parse(line);
+            if (target.contains("id")) {
+                result["id"] = target["id"];
+            }
+            // The catalog and the options are fixed for the lifetime of the
+            // process, so they are not part of the key.
+            std::string key = PlanCache::challenge_key(target);
+            auto cached = cache.find(key);
+            result["cached"] = cached != cache.end();
+            if (cached == cache.end()) {
+                long tick;
+                EventCollector collector;
+                solve(entities, index, target, options, collector, &tick);
+                json solution;
+                solution["events"] = collector.events;
+                if (options.run_simulation) {
+                    solution["simulated-tick"] = tick;
+                }
+                // Simply start over instead of tracking which entry is used
+                // least.
+                if (cache.size() >= max_cached) {
+                    cache.clear();
+                }
+                cached = cache.emplace(std::move(key), std::move(solution))
+                             .first;
+            }
+            result.update(cached->second);
+        } catch (const std::exception &e) {
+            result["error"] = e.what();
+        }
+        std::cout << result << std::endl;
+    }
+}
+
+// Prints the profiling counters to stderr when destroyed, i.e., after main
+// produced its regular output.
+class StatsReport {
+public:
+    ~StatsReport() { std::cerr << stats::report().dump(4) << std::endl; }
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    Options options;
+    options.run_simulation = std::erase(args, "--run-simulation") > 0;
+    if (std::erase(args, "--concurrent") > 0) {
+        options.schedule = Order::Schedule::concurrent;
+    }
+    bool batch = std::erase(args, "--batch") > 0;
+    bool serve_mode = std::erase(args, "--serve") > 0;
+    bool rates = std::erase(args, "--rates") > 0;
+    bool bom = std::erase(args, "--bom") > 0;
+    bool print_stats = std::erase(args, "--stats") > 0;
+    bool cheapest = std::erase(args, "--cheapest-recipes") > 0;
+    // Remove an option with a value from args and return the value.
+    auto take_value = [&](const std::string &option) {
+        std::optional<std::string> value;
+        if (auto it = std::ranges::find(args, option);
+            it != args.end() && it + 1 != args.end()) {
+            value = *(it + 1);
+            args.erase(it, it + 2);
+        }
+        return value;
+    };
+    std::optional<std::string> replay_path = take_value("--replay");
+    std::optional<std::string> validate_path = take_value("--validate");
+    if (auto ms = take_value("--optimize")) {
+        options.optimize.emplace();
+        options.optimize->budget = std::chrono::milliseconds(std::stol(*ms));
+        // Batch mode already uses all cores for different challenges.
+        if (batch) {
+            options.optimize->jobs = 1;
+        }
+    }
+    std::optional<std::filesystem::path> catalog_dir;
+    if (auto dir = take_value("--catalog")) {
+        catalog_dir = *dir;
+    }
+    std::optional<std::string> cache_dir = take_value("--cache");
+    bool bad_args
+        = batch ? args.empty() : args.size() != (serve_mode ? 0u : 1u);
+    if (bad_args
+        || (batch + serve_mode + rates + bom + replay_path.has_value()
+                + validate_path.has_value()
+            > 1)) {
+        std::cerr << "usage: " << argv[0]
+                  << " target.json [--run-simulation] [--concurrent]"
+                     " [--optimize ms] [--cheapest-recipes]"
+                  << std::endl
+                  << "       " << argv[0]
+                  << " --batch (target.json | directory)... [--run-simulation]"
+                     " [--concurrent] [--optimize ms]"
+                  << std::endl
+                  << "                [--cheapest-recipes]"
+                  << std::endl
+                  << "       " << argv[0]
+                  << " --serve [--run-simulation] [--concurrent]"
+                     " [--optimize ms] [--cheapest-recipes]"
+                  << std::endl
+                  << "       " << argv[0] << " --rates rates.json" << std::endl
+                  << "       " << argv[0] << " --bom target.json" << std::endl
+                  << "       " << argv[0] << " target.json --replay plan.json"
+                  << std::endl
+                  << "       " << argv[0] << " target.json --validate plan.json"
+                  << std::endl
+                  << "All modes accept --catalog directory to use the"
+                     " json-files in directory instead of the bundled ones,"
+                  << std::endl
+                  << "and --stats to print profiling counters to stderr"
+                     " (requires building with -DFBOO_STATS=ON)."
+                  << std::endl
+                  << "Solving modes accept --cache directory to store"
+                     " solutions and reuse them in later runs."
+                  << std::endl;
+        return EXIT_FAILURE;
     }
+    if (print_stats && !stats::enabled) {
+        std::cerr << "--stats requires building with -DFBOO_STATS=ON"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::uint64_t catalog_hash;
+    const catalog::Entities entities
+        = init_entities(catalog_dir, &catalog_hash);
+    const auto &[items, recipes, factories, technologies] = entities;
+    const EntityIndex index(recipes, factories, technologies);
+    std::optional<CostModel> costs;
+    if (cheapest) {
+        costs.emplace(recipes, index);
+        options.costs = &*costs;
+    }
+    std::optional<PlanCache> cache;
+    if (cache_dir) {
+        cache.emplace(*cache_dir);
+        options.cache = &*cache;
+        json prefix{{"catalog", catalog_hash},
+                    {"schedule", options.schedule},
+                    {"cheapest-recipes", cheapest},
+                    {"optimize", nullptr}};
+        if (options.optimize) {
+            prefix["optimize"] = options.optimize->budget.count();
+        }
+        options.cache_prefix = prefix.dump() + '\n';
+    }
+
+    // The tests only apply to the bundled catalog. fboo-embedded must not
+    // depend on the json-files of the challenges they use.
+    if (!catalog_dir && !embedded_catalog) {
+        std::clog.setstate(std::ios_base::failbit);
+        test_challenge1(entities);
+        test_challenge2(entities);
+        std::clog.clear();
+    }
+    // Only count the actual work, not the tests.
+    std::optional<StatsReport> stats_report;
+    if (print_stats) {
+        stats::reset();
+        stats_report.emplace();
+    }
+
+    if (batch) {
+        solve_batch(entities, index, collect_challenges(args), options);
+        return EXIT_SUCCESS;
+    }
+
+    if (serve_mode) {
+        serve(entities, index, options);
+        return EXIT_SUCCESS;
+    }
+
+    if (rates) {
+        // rates.json contains "goal-rates", a list of items (with "name") and
+        // the amount of them to produce per second ("rate").
+        json target;
+        std::ifstream(args.front()) >> target;
+        RateSolver::RateMap goal_rates;
+        for (const auto &g : target["goal-rates"]) {
+            goal_rates[g["name"]] += g["rate"].get<double>();
+        }
+        RateSolver solver(recipes, factories, index);
+        std::cout << json(solver.solve(goal_rates)) << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    json target;
+    std::ifstream(args.front()) >> target;
+
+    if (bom) {
+        if (!costs) {
+            costs.emplace(recipes, index);
+        }
+        BomSolver solver(index, *costs);
+        std::cout << json(solver.solve(target["goal-items"].get<ItemList>(),
+                                       target["initial-items"].get<ItemList>()))
+                  << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (replay_path || validate_path) {
+        // plan.json is a solution as printed by fboo, i.e., sorted by
+        // timestamp and without the initial factories of the challenge.
+        json result = replay(entities, target,
+                             replay_path ? *replay_path : *validate_path,
+                             validate_path.has_value());
+        std::cout << result << std::endl;
+        return result.value("valid", true) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    EventWriter writer(std::cout);
+    solve(entities, index, target, options, writer);
+    writer.close();
+    std::cout << std::endl;
 }
@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Options {
+    std::uint64_t seed = 1;
+    // Depth of the recipe DAG. Order expands the DAG into a tree, so the
+    // size of its plans grows exponentially with the depth.
+    int layers = 16;
+    int width = 20;         // Items per layer.
+    int fan_in = 4;         // Maximum number of ingredients per recipe.
+    int categories = 4;     // Crafting categories (besides mining).
+    int factory_types = 6;  // Besides the player.
+    int technologies = 50;  // Length of the technology chain.
+    int cycles = 10;        // Recipes that turn higher into lower items.
+    int goals = 3;          // Goal items of the challenge.
+    int factories = 2000;   // Factories in the event log.
+    long events = 100000;   // Events in the event log.
+};
+
+// The distributions of <random> are implementation-defined, so only the raw
+// output of the engine is used. This keeps scenarios identical everywhere.
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : engine(seed) {}
+
+    // Uniform in [lo, hi], slightly biased, which does not matter here.
+    long uniform(long lo, long hi) {
+        return lo + static_cast<long>(engine() % (hi - lo + 1));
+    }
+    bool chance(double p) { return uniform(0, 999'999) < p * 1'000'000; }
+    template <class T>
+    const T &pick(const std::vector<T> &v) {
+        return v[uniform(0, v.size() - 1)];
+    }
+
+private:
+    std::mt19937_64 engine;
+};
+
+const std::string mining = "mining";
+
+std::string numbered(const std::string &prefix, long i) {
+    return prefix + "-" + std::to_string(i);
+}
+
+json amounts(const std::map<std::string, int> &m) {
+    json j = json::array();
+    for (const auto &[name, amount] : m) {
+        j.push_back({{"name", name}, {"amount", amount}});
+    }
+    return j;
+}
+
+// A catalog in the schema of json/{item,recipe,factory,technology}.json.
+// Items are arranged in layers, and recipes only use items of lower layers as
+// ingredients (except for the cycle recipes). Ingredient and product amounts
+// are balanced, so the amount of raw items needed per item does not grow
+// exponentially with the depth.
+struct Catalog {
+    json items = json::object();
+    json recipes = json::object();
+    json factories = json::object();
+    json technologies = json::object();
+
+    std::vector<std::string> craft_categories;
+    std::vector<std::vector<std::string>> layers;
+    // Items that can be crafted without any research.
+    std::set<std::string> basic;
+    // Items that the player can craft alone, which is needed to build the
+    // first factories.
+    std::set<std::string> bootstrap;
+    // Enabled recipes by category, for the event log.
+    std::map<std::string, std::vector<std::string>> enabled_recipes;
+
+    void add_recipe(const std::string &name, const std::string &category,
+                    long energy, bool enabled,
+                    const std::map<std::string, int> &ingredients,
+                    const std::map<std::string, int> &products) {
+        recipes[name] = {{"category", category},
+                         {"enabled", enabled},
+                         {"energy", energy},
+                         {"ingredients", amounts(ingredients)},
+                         {"products", amounts(products)}};
+        if (enabled) {
+            enabled_recipes[category].push_back(name);
+        }
+    }
+
+    // Ingredients from the layers below layer (only allowed ones, if given),
+    // and the balanced amount of the product.
+    std::pair<std::map<std::string, int>, int> pick_ingredients(
+        Random &rand, const Options &o, std::size_t layer,
+        const std::set<std::string> *allowed = nullptr) {
+        std::vector<std::string> candidates;
+        // Prefer the layers right below for deep chains, but reach down to
+        // the raw items, too.
+        std::size_t lowest = layer > 3 ? layer - 3 : 0;
+        for (std::size_t l = lowest; l < layer; ++l) {
+            for (const std::string &s : layers[l]) {
+                if (!allowed || allowed->contains(s)) {
+                    candidates.push_back(s);
+                }
+            }
+        }
+        if (candidates.empty()) {
+            candidates = layers[0];
+        }
+
+        std::map<std::string, int> ingredients;
+        int total = 0;
+        for (long n = rand.uniform(1, o.fan_in); n > 0; --n) {
+            int amount = rand.uniform(1, 3);
+            ingredients[rand.pick(candidates)] += amount;
+            total += amount;
+        }
+        return {ingredients, total};
+    }
+
+    void generate(Random &rand, const Options &o) {
+        for (int c = 0; c < o.categories; ++c) {
+            craft_categories.push_back(numbered("crafting", c));
+        }
+
+        // Raw items, mined without ingredients.
+        layers.emplace_back();
+        for (int i = 0; i < std::max(2, o.width / 4); ++i) {
+            std::string name = numbered("raw", i);
+            items[name] = {{"type", "item"}};
+            add_recipe(name, mining, 60, true, {}, {{name, 1}});
+            layers[0].push_back(name);
+            basic.insert(name);
+            bootstrap.insert(name);
+        }
+
+        // Intermediate items. About a third of them needs research.
+        std::vector<std::string> locked;
+        for (int l = 1; l <= o.layers; ++l) {
+            layers.emplace_back();
+            for (int i = 0; i < o.width; ++i) {
+                std::string name = numbered(numbered("item", l), i);
+                items[name] = {{"type", "item"}};
+                auto [ingredients, total] = pick_ingredients(rand, o, l);
+                auto all_in = [&](const std::set<std::string> &set) {
+                    return std::ranges::all_of(ingredients, [&](auto &e) {
+                        return set.contains(e.first);
+                    });
+                };
+                bool enabled = !rand.chance(0.3) && all_in(basic);
+                const std::string &category = rand.pick(craft_categories);
+                add_recipe(name, category, rand.uniform(30, 300), enabled,
+                           ingredients, {{name, total}});
+                if (enabled) {
+                    basic.insert(name);
+                    if (category == craft_categories.front()
+                        && all_in(bootstrap)) {
+                        bootstrap.insert(name);
+                    }
+                } else {
+                    locked.push_back(name);
+                }
+                layers[l].push_back(name);
+            }
+        }
+
+        // Cycles: alternative recipes for lower items from higher ones.
+        for (int i = 0; i < o.cycles && o.layers >= 2; ++i) {
+            long high = rand.uniform(2, o.layers);
+            long low = rand.uniform(1, high - 1);
+            std::string name = numbered("cycle", i);
+            add_recipe(name, rand.pick(craft_categories),
+                       rand.uniform(30, 300), false,
+                       {{rand.pick(layers[high]), 1}},
+                       {{rand.pick(layers[low]), 1}});
+            locked.push_back(name);
+        }
+
+        // Factories. The player mines and crafts the first category, which
+        // is also the category of all factory recipes. These only use
+        // bootstrap items, so the player alone can build every factory.
+        factories["player"] = {
+            {"crafting_speed", 1.0},
+            {"crafting_categories", {mining, craft_categories.front()}}};
+        // Every category is crafted by at least one factory.
+        std::vector<std::set<std::string>> categories(o.factory_types);
+        for (std::size_t c = 0; c < craft_categories.size(); ++c) {
+            categories[c % o.factory_types].insert(craft_categories[c]);
+        }
+        categories[0].insert(mining);
+        const std::vector<double> speeds = {0.5, 0.75, 1, 1.25, 2};
+        for (int k = 0; k < o.factory_types; ++k) {
+            std::string name = numbered("factory", k);
+            std::set<std::string> &cats = categories[k];
+            for (const std::string &c : craft_categories) {
+                if (rand.chance(0.3)) {
+                    cats.insert(c);
+                }
+            }
+            if (cats.empty()) {
+                cats.insert(rand.pick(craft_categories));
+            }
+            factories[name] = {{"crafting_speed", rand.pick(speeds)},
+                               {"crafting_categories", cats}};
+            items[name] = {{"type", "item"}};
+            auto [ingredients, _] = pick_ingredients(
+                rand, o, std::min<std::size_t>(3, o.layers), &bootstrap);
+            add_recipe(name, craft_categories.front(), rand.uniform(60, 600),
+                       true, ingredients, {{name, 1}});
+        }
+
+        // Science packs, from increasingly higher (basic) layers.
+        std::vector<std::string> science;
+        for (int s = 0; s < 4; ++s) {
+            std::string name = numbered("science", s);
+            items[name] = {{"type", "item"}};
+            std::size_t layer = 1 + s * o.layers / 4;
+            auto [ingredients, _] = pick_ingredients(rand, o, layer, &basic);
+            add_recipe(name, craft_categories.front(), rand.uniform(60, 600),
+                       true, ingredients, {{name, 1}});
+            science.push_back(name);
+        }
+
+        // A chain of technologies (with some shortcuts to earlier ones), which
+        // unlocks the locked recipes.
+        std::vector<std::vector<std::string>> unlocks(o.technologies);
+        for (const std::string &r : locked) {
+            unlocks[rand.uniform(0, o.technologies - 1)].push_back(r);
+        }
+        for (int t = 0; t < o.technologies; ++t) {
+            std::set<std::string> prerequisites;
+            if (t > 0) {
+                prerequisites.insert(numbered("tech", t - 1));
+                if (rand.chance(0.2)) {
+                    prerequisites.insert(
+                        numbered("tech", rand.uniform(0, t - 1)));
+                }
+            }
+            std::map<std::string, int> ingredients;
+            std::size_t packs = 1 + t * science.size() / o.technologies;
+            for (std::size_t s = 0; s < packs; ++s) {
+                ingredients[science[s]] = rand.uniform(1, 5) * 10;
+            }
+            json effects = json::array();
+            for (const std::string &r : unlocks[t]) {
+                effects.push_back({{"type", "unlock-recipe"}, {"recipe", r}});
+            }
+            technologies[numbered("tech", t)]
+                = {{"effects", effects},
+                   {"ingredients", amounts(ingredients)},
+                   {"prerequisites", prerequisites}};
+        }
+    }
+
+    // Produce some of the items of the highest layers.
+    json challenge(Random &rand, const Options &o) const {
+        std::map<std::string, int> goals;
+        for (int g = 0; g < o.goals; ++g) {
+            const auto &layer = layers[rand.uniform(
+                std::max<long>(1, o.layers - 2), o.layers)];
+            goals[rand.pick(layer)] += rand.uniform(1, 10) * 10;
+        }
+        return {{"initial-items", json::array()},
+                {"initial-factories",
+                 {{{"factory-type", "player"},
+                   {"factory-id", 0},
+                   {"factory-name", "player"}}}},
+                {"goal-items", amounts(goals)}};
+    }
+};
+
+// A long, time-ordered event log for many factories, which only uses enabled
+// recipes and thus never requires research. It is valid, but most factories
+// starve a lot. The initial factories are part of the returned challenge,
+// like in the solutions printed by fboo.
+std::pair<json, json> event_log(Random &rand, const Options &o,
+                                const Catalog &c) {
+    struct Fac {
+        std::string type;
+        std::vector<std::string> recipes;  // The enabled ones it can craft.
+        long last_tick = -1;
+    };
+    std::map<long, Fac> alive;
+    std::vector<std::string> types;
+    for (const auto &[name, f] : c.factories.items()) {
+        if (name != "player") {
+            types.push_back(name);
+        }
+    }
+    auto make = [&](const std::string &type) {
+        Fac f{type, {}};
+        for (const auto &cat : c.factories[type]["crafting_categories"]) {
+            auto search = c.enabled_recipes.find(cat.get<std::string>());
+            if (search != c.enabled_recipes.end()) {
+                std::ranges::copy(search->second,
+                                  std::back_inserter(f.recipes));
+            }
+        }
+        return f;
+    };
+
+    json challenge = {{"initial-items", json::array()},
+                      {"initial-factories", json::array()},
+                      {"goal-items", json::array()}};
+    long next_fid = 0;
+    for (; next_fid < o.factories; ++next_fid) {
+        const std::string &type = rand.pick(types);
+        challenge["initial-factories"].push_back(
+            {{"factory-type", type},
+             {"factory-id", next_fid},
+             {"factory-name", numbered(type, next_fid)}});
+        alive.emplace(next_fid, make(type));
+    }
+
+    // Factories that were destroyed return to the inventory and may be built
+    // again (with a new id). Within a tick, destroying happens before
+    // building, and building before starting.
+    std::map<std::string, int> inventory;
+    json events = json::array();
+    long tick = 0;
+    for (long n = 0; n < o.events && !alive.empty(); ++n) {
+        tick += rand.uniform(0, 5);
+        auto it = alive.begin();
+        std::advance(it, rand.uniform(0, alive.size() - 1));
+        auto &[fid, f] = *it;
+
+        long action = rand.uniform(0, 99);
+        if (action < 2 && f.last_tick < tick) {
+            events.push_back({{"type", "destroy-destroy-event"},
+                              {"timestamp", tick},
+                              {"factory-id", fid}});
+            ++inventory[f.type];
+            alive.erase(it);
+        } else if (action < 4 && !inventory.empty()) {
+            auto [type, count] = *inventory.begin();
+            if (--inventory[type] == 0) {
+                inventory.erase(type);
+            }
+            events.push_back({{"type", "build-factory-event"},
+                              {"timestamp", tick},
+                              {"factory-id", next_fid},
+                              {"factory-type", type},
+                              {"factory-name", numbered(type, next_fid)}});
+            alive.emplace(next_fid, make(type));
+            alive.at(next_fid++).last_tick = tick;
+        } else if (action < 35) {
+            events.push_back({{"type", "stop-factory-event"},
+                              {"timestamp", tick},
+                              {"factory-id", fid}});
+            f.last_tick = tick;
+        } else if (!f.recipes.empty()) {
+            events.push_back({{"type", "start-factory-event"},
+                              {"timestamp", tick},
+                              {"factory-id", fid},
+                              {"recipe", rand.pick(f.recipes)}});
+            f.last_tick = tick;
+        }
+    }
+    events.push_back({{"type", "victory-event"}, {"timestamp", tick + 1}});
+    return {challenge, events};
+}
+
+void write(const std::filesystem::path &path, const json &j, int indent) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("cannot write " + path.string());
+    }
+    out << j.dump(indent) << std::endl;
+}
+
+}  // namespace
+
+// Generate a synthetic scenario from a seed: a catalog, a challenge for
+// Order, and an event log for game::Simulation.
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (args.empty() || args.size() % 2 != 1) {
+        std::cerr << "usage: " << argv[0]
+                  << " output-directory [--seed n] [--layers n] [--width n]"
+                     " [--fan-in n] [--categories n] [--factory-types n]"
+                     " [--technologies n] [--cycles n] [--goals n]"
+                     " [--factories n] [--events n]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Options o;
+    std::map<std::string, long *> longs = {{"--events", &o.events}};
+    std::map<std::string, int *> ints = {
+        {"--layers", &o.layers},         {"--width", &o.width},
+        {"--fan-in", &o.fan_in},         {"--categories", &o.categories},
+        {"--factory-types", &o.factory_types},
+        {"--technologies", &o.technologies},
+        {"--cycles", &o.cycles},         {"--goals", &o.goals},
+        {"--factories", &o.factories}};
+    for (std::size_t i = 1; i < args.size(); i += 2) {
+        const std::string &key = args[i], &value = args[i + 1];
+        if (key == "--seed") {
+            o.seed = std::stoull(value);
+        } else if (longs.contains(key)) {
+            *longs[key] = std::stol(value);
+        } else if (ints.contains(key)) {
+            *ints[key] = std::stoi(value);
+        } else {
+            std::cerr << "unknown option " << key << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (o.layers < 1 || o.width < 1 || o.fan_in < 1 || o.categories < 1
+        || o.factory_types < 1 || o.technologies < 1 || o.goals < 0
+        || o.factories < 1 || o.events < 0 || o.cycles < 0) {
+        std::cerr << "invalid option value" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Random rand(o.seed);
+    Catalog c;
+    c.generate(rand, o);
+
+    std::filesystem::path dir = args.front();
+    std::filesystem::create_directories(dir);
+    write(dir / "item.json", c.items, 4);
+    write(dir / "recipe.json", c.recipes, 4);
+    write(dir / "factory.json", c.factories, 4);
+    write(dir / "technology.json", c.technologies, 4);
+    write(dir / "challenge.json", c.challenge(rand, o), 4);
+
+    auto [challenge, events] = event_log(rand, o, c);
+    write(dir / "events-challenge.json", challenge, 4);
+    write(dir / "events.json", events, -1);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <vector>
+
+#include "cost.hpp"
+#include "entity.hpp"
+
+// Bill of materials: which recipes have to run how often, and which items
+// have to be mined, to produce some goal items. Every item is produced by its
+// cheapest recipe (according to a CostModel) on the fastest factory of its
+// category, and amounts are rounded up to whole executions like in Order.
+// Initial items are used before anything is produced. By-products only cover
+// the demand of items that are handled later. The recipe graph is resolved
+// once, so every solve takes time linear in the number of items.
+class BomSolver {
+public:
+    struct RecipeCount {
+        const Recipe *recipe;
+        const Factory *factory;
+        int executions;
+        long ticks;  // Of all executions on factory.
+    };
+
+    struct Result {
+        // The ingredients of every recipe are produced by earlier recipes.
+        std::vector<RecipeCount> recipes;
+        // Produced by recipes without ingredients, i.e., mined.
+        ItemCount raw;
+        // Produced by recipes with ingredients.
+        ItemCount intermediates;
+        ItemCount initial_items_used;
+        // Neither available nor producible.
+        ItemCount missing;
+        // Produced beyond the demand, by rounding or as by-products.
+        ItemCount surplus;
+        // Lower bounds: all recipes run one after the other, or every
+        // execution runs on its own factory.
+        long total_ticks = 0;
+        long critical_path_ticks = 0;
+    };
+
+    BomSolver(const EntityIndex &index, const CostModel &costs);
+
+    Result solve(const ItemList &goal_items,
+                 const ItemList &initial_items = {}) const;
+
+private:
+    const EntityIndex &index;
+    // Indexed by item id.
+    std::vector<const Recipe *> recipe_of;  // nullptr if not producible.
+    std::vector<const Factory *> factory_of;
+    // Item ids, every item before the ingredients of its recipe.
+    std::vector<int> order;
+};
+
+void to_json(nlohmann::json &j, const BomSolver::Result &r);
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "event.hpp"
+
+// Solutions stored as json-files in a directory, so repeated challenges are
+// answered by a read instead of Order::compute. An entry is found by a hash
+// of its key, which must contain everything the solution depends on: the
+// (normalized) challenge, a hash of the catalog, and the solver options. Since
+// the catalog is part of the key, entries of an older catalog are simply not
+// found anymore. Entries are written atomically, so multiple threads or
+// processes can share a cache.
+class PlanCache {
+public:
+    struct Entry {
+        EventList events;
+        // Only known if the solution was simulated.
+        std::optional<long> tick;
+    };
+
+    // Creates dir if it does not exist.
+    explicit PlanCache(std::filesystem::path dir);
+
+    // Returns std::nullopt if there is no (readable) entry for key. The
+    // events refer to the given entities.
+    std::optional<Entry> find(const std::string &key, const RecipeMap &recipes,
+                              const FactoryMap &factories,
+                              const TechnologyMap &technologies) const;
+    void store(const std::string &key, const Entry &entry) const;
+
+    // 64-bit FNV-1a, continuing from a previous hash.
+    static std::uint64_t hash(std::string_view data,
+                              std::uint64_t h = 0xcbf29ce484222325);
+    // Hash of the contents of all files, in the given order. Throws
+    // std::runtime_error if a file cannot be read.
+    static std::uint64_t hash_files(
+        const std::vector<std::filesystem::path> &paths);
+    // The parts of a challenge that determine its solution, as a canonical
+    // string (the keys of json-objects are sorted, whitespace is dropped,
+    // items are merged and sorted by name, factories are sorted by id).
+    static std::string challenge_key(const nlohmann::json &target);
+
+private:
+    std::filesystem::path path_of(const std::string &key) const;
+
+    std::filesystem::path dir;
+};
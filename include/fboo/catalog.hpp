@@ -0,0 +1,366 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "entity.hpp"
+
+namespace catalog {
+
+using Entities = std::tuple<ItemMap, RecipeMap, FactoryMap, TechnologyMap>;
+
+// Read the json-files for each type of entity and construct the appropriate
+// C++-objects for them. Return a tuple containing the unordered maps of all
+// items, recipes, factories, and technologies (in that order).
+Entities load_json(const std::string &item_path,
+                   const std::string &recipe_path,
+                   const std::string &factory_path,
+                   const std::string &technology_path);
+
+// Hash of the contents of the json-files. A binary catalog stores the hash of
+// the json-files it was generated from, so it can be told apart from an
+// outdated one. Throws std::runtime_error if a file cannot be read.
+std::uint64_t hash_json(const std::string &item_path,
+                        const std::string &recipe_path,
+                        const std::string &factory_path,
+                        const std::string &technology_path);
+
+// Convert the json-files into the compact binary format described below.
+void write_binary(std::ostream &os, const std::string &item_path,
+                  const std::string &recipe_path,
+                  const std::string &factory_path,
+                  const std::string &technology_path);
+
+// Convert the json-files into a C++ source file that defines
+// embedded_tables() (see below) with constexpr tables in the same format.
+void write_cpp(std::ostream &os, const std::string &item_path,
+               const std::string &recipe_path,
+               const std::string &factory_path,
+               const std::string &technology_path);
+
+// Layout of the binary catalog. All integers are stored in native byte order,
+// so a catalog is only valid on the machine type it was generated on. The
+// file starts with a Header, followed by the sections it references. Every
+// table is sorted by name, which allows lookups via binary search directly on
+// the mapped memory.
+namespace format {
+
+inline constexpr char magic[8] = {'F', 'B', 'O', 'O', 'C', 'A', 'T', '\0'};
+inline constexpr std::uint32_t version = 2;
+
+// Slice of the string section.
+struct Str {
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+// Slice of one of the list sections (amounts or names).
+struct Range {
+    std::uint32_t begin;
+    std::uint32_t count;
+};
+
+struct Amount {
+    Str name;
+    std::int32_t amount;
+};
+
+struct Item {
+    Str name;
+    Str type;
+};
+
+struct Recipe {
+    Str name;
+    Str category;
+    std::int32_t required_energy;
+    std::uint32_t enabled;
+    Range ingredients;  // Into the amount section.
+    Range products;     // Into the amount section.
+};
+
+struct Factory {
+    Str name;
+    double crafting_speed;
+    Range crafting_categories;  // Into the name section.
+};
+
+struct Technology {
+    Str name;
+    Range prerequisites;     // Into the name section.
+    Range ingredients;       // Into the amount section.
+    Range unlocked_recipes;  // Into the name section.
+};
+
+// Byte offset and number of elements of a section.
+struct Section {
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t file_size;
+    std::uint64_t source_hash;  // See hash_json.
+    Section items, recipes, factories, technologies, amounts, names, strings;
+};
+
+// The sections of a catalog, either in a mapped file or in static memory.
+struct Tables {
+    std::span<const Item> items;
+    std::span<const Recipe> recipes;
+    std::span<const Factory> factories;
+    std::span<const Technology> technologies;
+    std::span<const Amount> amounts;
+    std::span<const Str> names;
+    std::string_view strings;
+};
+
+}  // namespace format
+
+// Defined by the source generated with write_cpp, which is only linked into
+// fboo-embedded.
+const format::Tables &embedded_tables();
+
+class Catalog;
+
+// Lightweight handles into a mapped catalog. They are only valid as long as
+// the Catalog they were obtained from.
+class AmountView {
+public:
+    AmountView(const Catalog &c, const format::Amount &a) : c(&c), a(&a) {}
+
+    std::string_view get_name() const;
+    int get_amount() const { return a->amount; }
+
+private:
+    const Catalog *c;
+    const format::Amount *a;
+};
+
+// Random access range over a slice of one of the list sections.
+template <class Rec, class View>
+class ListView {
+public:
+    class iterator {
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = View;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        iterator(const Catalog *c, const Rec *r) : c(c), r(r) {}
+
+        View operator*() const { return View(*c, *r); }
+        View operator[](difference_type n) const { return *(*this + n); }
+        iterator &operator++() { ++r; return *this; }
+        iterator operator++(int) { auto tmp = *this; ++r; return tmp; }
+        iterator &operator--() { --r; return *this; }
+        iterator operator--(int) { auto tmp = *this; --r; return tmp; }
+        iterator &operator+=(difference_type n) { r += n; return *this; }
+        iterator &operator-=(difference_type n) { r -= n; return *this; }
+        friend iterator operator+(iterator it, difference_type n) {
+            return it += n;
+        }
+        friend iterator operator+(difference_type n, iterator it) {
+            return it += n;
+        }
+        friend iterator operator-(iterator it, difference_type n) {
+            return it -= n;
+        }
+        friend difference_type operator-(iterator a, iterator b) {
+            return a.r - b.r;
+        }
+        friend auto operator<=>(iterator a, iterator b) { return a.r <=> b.r; }
+        friend bool operator==(iterator a, iterator b) { return a.r == b.r; }
+
+    private:
+        const Catalog *c = nullptr;
+        const Rec *r = nullptr;
+    };
+
+    ListView(const Catalog &c, std::span<const Rec> recs)
+        : c(&c), recs(recs) {}
+
+    iterator begin() const { return {c, recs.data()}; }
+    iterator end() const { return {c, recs.data() + recs.size()}; }
+    std::size_t size() const { return recs.size(); }
+    bool empty() const { return recs.empty(); }
+    View operator[](std::size_t i) const { return View(*c, recs[i]); }
+
+    // Linear search, lists are short.
+    std::optional<View> find(std::string_view name) const {
+        for (View v : *this) {
+            if (v.get_name() == name) {
+                return v;
+            }
+        }
+        return std::nullopt;
+    }
+    bool contains(std::string_view name) const {
+        return find(name).has_value();
+    }
+
+private:
+    const Catalog *c;
+    std::span<const Rec> recs;
+};
+
+class NameView {
+public:
+    NameView(const Catalog &c, const format::Str &s) : c(&c), s(&s) {}
+
+    std::string_view get_name() const;
+    operator std::string_view() const { return get_name(); }
+
+private:
+    const Catalog *c;
+    const format::Str *s;
+};
+
+using AmountList = ListView<format::Amount, AmountView>;
+using NameList = ListView<format::Str, NameView>;
+
+class ItemView {
+public:
+    ItemView(const Catalog &c, const format::Item &i) : c(&c), i(&i) {}
+
+    std::string_view get_name() const;
+    std::string_view get_type() const;
+
+private:
+    const Catalog *c;
+    const format::Item *i;
+};
+
+class RecipeView {
+public:
+    RecipeView(const Catalog &c, const format::Recipe &r)
+        : c(&c), r(&r) {}
+
+    std::string_view get_name() const;
+    std::string_view get_category() const;
+    bool is_enabled() const { return r->enabled; }
+    int get_required_energy() const { return r->required_energy; }
+    AmountList get_ingredients() const;
+    AmountList get_products() const;
+
+private:
+    const Catalog *c;
+    const format::Recipe *r;
+};
+
+class FactoryView {
+public:
+    FactoryView(const Catalog &c, const format::Factory &f)
+        : c(&c), f(&f) {}
+
+    std::string_view get_name() const;
+    double get_crafting_speed() const { return f->crafting_speed; }
+    NameList get_crafting_categories() const;
+
+private:
+    const Catalog *c;
+    const format::Factory *f;
+};
+
+class TechnologyView {
+public:
+    TechnologyView(const Catalog &c, const format::Technology &t)
+        : c(&c), t(&t) {}
+
+    std::string_view get_name() const;
+    NameList get_prerequisites() const;
+    AmountList get_ingredients() const;
+    NameList get_unlocked_recipes() const;
+
+private:
+    const Catalog *c;
+    const format::Technology *t;
+};
+
+// Read-only table of one entity type, sorted by name. Mirrors the lookup
+// interface of the unordered maps (find, at, contains).
+template <class Rec, class View>
+class TableView : public ListView<Rec, View> {
+public:
+    using ListView<Rec, View>::ListView;
+
+    std::optional<View> find(std::string_view name) const {
+        auto it = std::ranges::lower_bound(*this, name, {}, &View::get_name);
+        if (it == this->end() || (*it).get_name() != name) {
+            return std::nullopt;
+        }
+        return *it;
+    }
+    View at(std::string_view name) const {
+        if (auto v = find(name)) {
+            return *v;
+        }
+        throw std::out_of_range("no such entity in catalog: "
+                                + std::string(name));
+    }
+    bool contains(std::string_view name) const {
+        return find(name).has_value();
+    }
+};
+
+using ItemTable = TableView<format::Item, ItemView>;
+using RecipeTable = TableView<format::Recipe, RecipeView>;
+using FactoryTable = TableView<format::Factory, FactoryView>;
+using TechnologyTable = TableView<format::Technology, TechnologyView>;
+
+// A binary catalog, mapped read-only into memory, or tables that are compiled
+// into the program. Accessing it does not allocate; only to_entities creates
+// the (heap-based) entity maps used by Order and game::Simulation.
+class Catalog {
+public:
+    explicit Catalog(const std::string &path);
+    // The tables must outlive the Catalog.
+    explicit Catalog(const format::Tables &tables) : tables(tables) {}
+    ~Catalog();
+
+    Catalog(const Catalog &) = delete;
+    Catalog &operator=(const Catalog &) = delete;
+
+    ItemTable items() const;
+    RecipeTable recipes() const;
+    FactoryTable factories() const;
+    TechnologyTable technologies() const;
+
+    // The hash_json of the json-files a mapped file was generated from.
+    std::uint64_t get_source_hash() const { return source_hash; }
+
+    Entities to_entities() const;
+
+private:
+    friend class AmountView;
+    friend class NameView;
+    friend class ItemView;
+    friend class RecipeView;
+    friend class FactoryView;
+    friend class TechnologyView;
+
+    template <class T>
+    std::span<const T> section(const format::Section &s) const;
+    std::string_view str(const format::Str &s) const;
+    AmountList amounts(const format::Range &r) const;
+    NameList names(const format::Range &r) const;
+
+    // Only set for a mapped file.
+    const std::byte *data = nullptr;
+    std::size_t size = 0;
+    std::uint64_t source_hash = 0;
+    format::Tables tables;
+};
+
+}  // namespace catalog
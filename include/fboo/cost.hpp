@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+
+#include "entity.hpp"
+
+// Estimates how many ticks it takes to produce items from scratch: every
+// recipe runs on the fastest factory of its category, and its ingredients are
+// produced with their cheapest recipes as well. Only derivations without
+// cycles are considered, so an estimate is an upper bound: a productive cycle
+// (e.g., coal -> burner -> coal) may be cheaper, or be the only way to
+// produce an item that is then estimated as infinity. Like EntityIndex, the
+// model is computed once and can be shared.
+class CostModel {
+public:
+    CostModel(const RecipeMap &all_recipes, const EntityIndex &index);
+
+    // Estimated ticks per unit of item, infinity if item cannot be produced
+    // without a cycle.
+    double get_item_cost(const std::string &item) const;
+    // Estimated ticks per unit of product when producing it with r.
+    double get_recipe_cost(const Recipe &r, const std::string &product) const;
+
+private:
+    std::unordered_map<std::string, double> item_costs;
+    // Ticks of one execution, including the ingredients.
+    std::unordered_map<const Recipe *, double> recipe_costs;
+};
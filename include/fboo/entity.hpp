@@ -98,19 +98,25 @@ public:
     const ItemCount &get_ingredients() const { return ingredients; }
     const ItemCount &get_products() const { return products; }
 
-    void set_energy(const class Factory &f);
-    int tick() { return --remaining_energy; }
-
 private:
     std::string category;
     int required_energy;  // Amount of ticks to execute the recipe.
-    int remaining_energy = 0;
     bool enabled;
     ItemCount ingredients, products;
 };
 
 using RecipeMap = std::unordered_map<std::string, Recipe>;
 
+// How many times does r need to be executed to produce product_name
+// product_amount many times?
+int calc_execution_times(const Recipe &r, const std::string &product_name,
+                         int product_amount);
+// How many ingredient_name need to be created in order to produce product_name
+// product_amount many times using r?
+int calc_ingredient_amount(const Recipe &r, const std::string &product_name,
+                           int product_amount,
+                           const std::string &ingredient_name);
+
 class Factory : public Entity {
 public:
     Factory(std::string name, double crafting_speed,
@@ -168,6 +174,121 @@ private:
 
 using TechnologyMap = std::unordered_map<std::string, Technology>;
 
+// The prerequisite graph of all technologies, resolved once. Technologies have
+// dense ids in topological order, i.e., every technology has a larger id than
+// its prerequisites.
+class TechnologyTree {
+public:
+    using TechnologyList = std::vector<const Technology *>;
+    // Bitset, indexed by id.
+    using TechnologySet = std::vector<bool>;
+
+    // Throws std::invalid_argument if the prerequisites form a cycle.
+    explicit TechnologyTree(const TechnologyMap &all_technologies);
+
+    std::size_t size() const { return technologies.size(); }
+    int get_id(const Technology &t) const { return ids.at(&t); }
+    const Technology &get_technology(int id) const {
+        return *technologies[id];
+    }
+
+    // t and all of its transitive prerequisites.
+    const TechnologySet &get_closure(const Technology &t) const {
+        return closures[get_id(t)];
+    }
+    // The closure of t in the order in which a depth-first search researches
+    // it: every technology after its prerequisites, t last.
+    const TechnologyList &get_research_order(const Technology &t) const {
+        return research_orders[get_id(t)];
+    }
+    // The technologies of get_research_order(t) that are not unlocked yet,
+    // i.e., the shortest sequence that unlocks t.
+    TechnologyList get_missing(const Technology &t,
+                               const TechnologySet &unlocked) const;
+
+    // The ingredients (science packs) of the whole closure of t.
+    const ItemCount &get_total_cost(const Technology &t) const {
+        return total_costs[get_id(t)];
+    }
+    // The ingredients of get_missing(t, unlocked).
+    ItemCount get_cost(const Technology &t,
+                       const TechnologySet &unlocked) const;
+
+    // The shortest sequence of technologies that unlocks r, over all
+    // technologies that unlock it. Empty if r is enabled initially. Throws
+    // std::invalid_argument if no technology unlocks r.
+    TechnologyList get_research_sequence(const Recipe &r,
+                                         const TechnologySet &unlocked) const;
+
+private:
+    TechnologyList technologies;
+    std::unordered_map<const Technology *, int> ids;
+    std::vector<TechnologySet> closures;
+    std::vector<TechnologyList> research_orders;
+    std::vector<ItemCount> total_costs;
+    // Recipe name to the technologies that unlock it.
+    std::unordered_map<std::string, TechnologyList> unlocked_by;
+};
+
+// Reverse lookups into the entity maps. The maps never change after loading,
+// so the index is built once and can be shared by all users of the maps.
+// Every list preserves the iteration order of the map it was built from.
+class EntityIndex {
+public:
+    using RecipeList = std::vector<const Recipe *>;
+    using FactoryList = std::vector<const Factory *>;
+
+    EntityIndex(const RecipeMap &all_recipes, const FactoryMap &all_factories,
+                const TechnologyMap &all_technologies);
+
+    // Recipes that have item among their products.
+    const RecipeList &get_producers(const std::string &item) const {
+        return lookup(producers, item);
+    }
+    // Recipes that have item among their ingredients.
+    const RecipeList &get_consumers(const std::string &item) const {
+        return lookup(consumers, item);
+    }
+    // Factories that can craft recipes of category.
+    const FactoryList &get_factories(const std::string &category) const {
+        return lookup(factories, category);
+    }
+    // Returns nullptr if r is not unlocked by any technology.
+    const Technology *get_unlocking_technology(const Recipe &r) const {
+        auto search = unlocked_by.find(&r);
+        return search == unlocked_by.end() ? nullptr : search->second;
+    }
+    const TechnologyTree &get_technology_tree() const {
+        return technology_tree;
+    }
+
+    // Dense ids in [0, get_item_count()) for all items that occur in a recipe,
+    // a technology or as a factory. Returns -1 for unknown items.
+    int get_item_id(const std::string &item) const {
+        auto search = item_ids.find(item);
+        return search == item_ids.end() ? -1 : search->second;
+    }
+    std::size_t get_item_count() const { return item_ids.size(); }
+    const std::string &get_item_name(int id) const { return item_names[id]; }
+
+private:
+    template <class Map>
+    static const typename Map::mapped_type &lookup(const Map &m,
+                                                   const std::string &key) {
+        static const typename Map::mapped_type empty;
+        auto search = m.find(key);
+        return search == m.end() ? empty : search->second;
+    }
+
+    std::unordered_map<std::string, RecipeList> producers;
+    std::unordered_map<std::string, RecipeList> consumers;
+    std::unordered_map<std::string, FactoryList> factories;
+    std::unordered_map<const Recipe *, const Technology *> unlocked_by;
+    std::unordered_map<std::string, int> item_ids;
+    std::vector<std::string> item_names;
+    TechnologyTree technology_tree;
+};
+
 class FactoryIdMap {
 public:
     using fid_t = int;
@@ -1,47 +1,55 @@
 #pragma once
+#include <istream>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
 #include "entity.hpp"
 
+// Events are plain values without virtual functions. A plan is a contiguous
+// EventList of AnyEvent (see below), so storing an event costs no allocation
+// of its own and inspecting it no dynamic_cast. Events refer to recipes,
+// factories, and technologies by pointer, so they must not outlive the maps
+// these belong to. Names are only looked up when converting from or to json.
 class Event {
 public:
     Event(long timestamp) : timestamp(timestamp) {}
-    virtual ~Event() = default;
 
-    // TODO as_json is bad, duplicate code, but idk how to fix it
-    virtual nlohmann::json as_json() const { throw std::bad_function_call(); }
-    virtual std::string to_string() const;
-    virtual std::string get_type() const { throw std::bad_function_call(); }
     long get_timestamp() const { return timestamp; }
 
+    bool operator==(const Event &) const = default;
+
 protected:
+    std::string to_string(std::string_view type) const;
+
     long timestamp;
 };
 
-using EventList = std::vector<std::shared_ptr<Event>>;
-void to_json(nlohmann::json &j, const EventList &l);
-
 class ResearchEvent : public Event {
 public:
-    inline static std::string type = "research-event";
-
-    ResearchEvent(long timestamp, std::string technology)
-        : Event(timestamp), technology(technology) {}
+    static constexpr std::string_view type = "research-event";
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(ResearchEvent, type, timestamp, technology);
+    ResearchEvent(long timestamp, const Technology &technology)
+        : Event(timestamp), technology(&technology) {}
 
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
+    friend void to_json(nlohmann::json &j, const ResearchEvent &e) {
+        j = nlohmann::json{{"type", e.type},
+                           {"timestamp", e.timestamp},
+                           {"technology", e.technology->get_name()}};
     }
-    std::string to_string() const override;
-    std::string get_type() const override { return type; };
-    std::string get_technology() const { return technology; }
+
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const;
+    std::string_view get_type() const { return type; }
+    bool operator==(const ResearchEvent &) const = default;
+    const Technology &get_technology() const { return *technology; }
 
 private:
-    std::string technology;
+    const Technology *technology;
 };
 
 class FactoryEvent : public Event {
@@ -49,56 +57,49 @@ public:
     FactoryEvent(long timestamp, FactoryIdMap::fid_t factory_id)
         : Event(timestamp), factory_id(factory_id) {}
 
-    virtual std::string to_string() const override;
     FactoryIdMap::fid_t get_factory_id() const { return factory_id; }
 
+    bool operator==(const FactoryEvent &) const = default;
+
 protected:
+    std::string to_string(std::string_view type) const;
+
     FactoryIdMap::fid_t factory_id;
 };
 
 class BuildEvent : public FactoryEvent {
 public:
-    inline static std::string type = "build-factory-event";
+    static constexpr std::string_view type = "build-factory-event";
     static constexpr int initial = -1;
 
-    BuildEvent(long timestamp, std::string type, std::string name,
-               FactoryIdMap::fid_t factory_id)
-        : FactoryEvent(timestamp, factory_id),
-          factory_type(type),
-          factory_name(name) {}
-
+    // The factory-name is not stored, but derived from the factory. The
+    // factory-name of a challenge or plan is only a label.
     BuildEvent(long timestamp, const Factory &factory,
                FactoryIdMap::fid_t factory_id)
-        : BuildEvent(timestamp, factory.get_name(), factory.to_string(),
-                     factory_id) {}
+        : FactoryEvent(timestamp, factory_id), factory(&factory) {}
 
     friend void to_json(nlohmann::json &j, const BuildEvent &e) {
         // Replace '_' with '-' for the necessary fields.
         j = nlohmann::json{{"type", e.type},
                            {"timestamp", e.timestamp},
                            {"factory-id", e.factory_id},
-                           {"factory-type", e.factory_type},
-                           {"factory-name", e.factory_name}};
+                           {"factory-type", e.factory->get_name()},
+                           {"factory-name", e.factory->to_string()}};
     }
 
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
-    }
-    std::string to_string() const override;
-    std::string get_type() const override { return type; };
-    std::string get_factory_type() const { return factory_type; }
-    std::string get_factory_name() const { return factory_name; }
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const;
+    std::string_view get_type() const { return type; }
+    bool operator==(const BuildEvent &) const = default;
+    const Factory &get_factory() const { return *factory; }
 
 private:
-    std::string factory_type;
-    std::string factory_name;
+    const Factory *factory;
 };
 
 class DestroyEvent : public FactoryEvent {
 public:
-    inline static std::string type = "destroy-destroy-event";
+    static constexpr std::string_view type = "destroy-destroy-event";
 
     DestroyEvent(long timestamp, FactoryIdMap::fid_t factory_id)
         : FactoryEvent(timestamp, factory_id) {}
@@ -110,50 +111,41 @@ public:
                            {"factory-id", e.factory_id}};
     }
 
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
-    }
-    std::string get_type() const override { return type; };
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const { return FactoryEvent::to_string(type); }
+    std::string_view get_type() const { return type; }
+    bool operator==(const DestroyEvent &) const = default;
 };
 
 class StartEvent : public FactoryEvent {
 public:
-    inline static std::string type = "start-factory-event";
+    static constexpr std::string_view type = "start-factory-event";
 
     StartEvent(long timestamp, FactoryIdMap::fid_t factory_id,
                const Recipe &recipe)
-        : StartEvent(timestamp, factory_id, recipe.get_name()) {}
-
-    StartEvent(long timestamp, FactoryIdMap::fid_t factory_id,
-               std::string recipe)
-        : FactoryEvent(timestamp, factory_id), recipe(recipe) {}
+        : FactoryEvent(timestamp, factory_id), recipe(&recipe) {}
 
     friend void to_json(nlohmann::json &j, const StartEvent &e) {
         // Replace '_' with '-' for the necessary fields.
         j = nlohmann::json{{"type", e.type},
                            {"timestamp", e.timestamp},
                            {"factory-id", e.factory_id},
-                           {"recipe", e.recipe}};
+                           {"recipe", e.recipe->get_name()}};
     }
 
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
-    }
-    std::string to_string() const override;
-    std::string get_type() const override { return type; };
-    std::string get_recipe() const { return recipe; }
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const;
+    std::string_view get_type() const { return type; }
+    bool operator==(const StartEvent &) const = default;
+    const Recipe &get_recipe() const { return *recipe; }
 
 private:
-    std::string recipe;
+    const Recipe *recipe;
 };
 
 class StopEvent : public FactoryEvent {
 public:
-    inline static std::string type = "stop-factory-event";
+    static constexpr std::string_view type = "stop-factory-event";
 
     StopEvent(long timestamp, FactoryIdMap::fid_t factory_id)
         : FactoryEvent(timestamp, factory_id) {}
@@ -165,26 +157,108 @@ public:
                            {"factory-id", e.factory_id}};
     }
 
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
-    }
-    std::string get_type() const override { return type; };
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const { return FactoryEvent::to_string(type); }
+    std::string_view get_type() const { return type; }
+    bool operator==(const StopEvent &) const = default;
 };
 
 class VictoryEvent : public Event {
 public:
-    inline static std::string type = "victory-event";
+    static constexpr std::string_view type = "victory-event";
 
     VictoryEvent(long timestamp) : Event(timestamp) {}
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(VictoryEvent, type, timestamp);
-
-    nlohmann::json as_json() const override {
-        nlohmann::json j;
-        to_json(j, *this);
-        return j;
+    friend void to_json(nlohmann::json &j, const VictoryEvent &e) {
+        j = nlohmann::json{{"type", e.type}, {"timestamp", e.timestamp}};
     }
-    std::string get_type() const override { return type; };
+
+    nlohmann::json as_json() const { return *this; }
+    std::string to_string() const { return Event::to_string(type); }
+    std::string_view get_type() const { return type; }
+    bool operator==(const VictoryEvent &) const = default;
+};
+
+// The alternatives are listed in the order in which a tick executes them (see
+// game::Simulation::advance), so index() can be used as a sort key.
+using AnyEvent = std::variant<ResearchEvent, StopEvent, DestroyEvent,
+                              BuildEvent, StartEvent, VictoryEvent>;
+using EventList = std::vector<AnyEvent>;
+
+long get_timestamp(const AnyEvent &e);
+// The factory id of a FactoryEvent, 0 for all other events.
+FactoryIdMap::fid_t get_factory_id(const AnyEvent &e);
+std::string_view get_type(const AnyEvent &e);
+std::string to_string(const AnyEvent &e);
+std::ostream &operator<<(std::ostream &os, const AnyEvent &e);
+
+void to_json(nlohmann::json &j, const AnyEvent &e);
+void to_json(nlohmann::json &j, const EventList &l);
+// Throws std::invalid_argument if j has an unknown type or refers to an
+// unknown recipe, factory, or technology.
+AnyEvent event_from_json(const nlohmann::json &j, const RecipeMap &recipes,
+                         const FactoryMap &factories,
+                         const TechnologyMap &technologies);
+
+// Receives events one at a time, in the order in which they are produced.
+class EventSink {
+public:
+    virtual ~EventSink() = default;
+
+    virtual void push(const AnyEvent &e) = 0;
+};
+
+class EventCollector : public EventSink {
+public:
+    void push(const AnyEvent &e) override { events.push_back(e); }
+
+    EventList events;
+};
+
+// Writes the events to os as they arrive, in the same format as printing
+// nlohmann::json(events). Only one event at a time is converted to json, so
+// arbitrarily long plans can be written in constant extra memory.
+class EventWriter : public EventSink {
+public:
+    explicit EventWriter(std::ostream &os) : os(os) {}
+
+    void push(const AnyEvent &e) override;
+    // Terminate the json-array. No events may be pushed afterwards.
+    void close();
+
+private:
+    std::ostream &os;
+    bool empty = true;
+};
+
+// Produces events one at a time, e.g. while reading them from a file.
+class EventSource {
+public:
+    virtual ~EventSource() = default;
+
+    // Returns std::nullopt once all events have been produced.
+    virtual std::optional<AnyEvent> next() = 0;
+};
+
+// Reads a json-array of events (as written by EventWriter) incrementally, so
+// only one event at a time is held in memory. Throws std::invalid_argument if
+// the input is malformed (see also event_from_json).
+class EventReader : public EventSource {
+public:
+    EventReader(std::istream &is, const RecipeMap &recipes,
+                const FactoryMap &factories, const TechnologyMap &technologies)
+        : is(is),
+          recipes(recipes),
+          factories(factories),
+          technologies(technologies) {}
+
+    std::optional<AnyEvent> next() override;
+
+private:
+    std::istream &is;
+    const RecipeMap &recipes;
+    const FactoryMap &factories;
+    const TechnologyMap &technologies;
+    bool started = false;
+    bool done = false;
 };
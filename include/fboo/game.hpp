@@ -1,17 +1,67 @@
 #pragma once
-#include <deque>
+#include <cstdint>
+#include <memory_resource>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <queue>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "entity.hpp"
 #include "event.hpp"
+#include "util.hpp"
 
 namespace game {
 
+// Thrown by State if the amount of an item would become negative.
+class InventoryError : public std::invalid_argument {
+public:
+    explicit InventoryError(std::string item)
+        : std::invalid_argument("item amount must not be < 0"),
+          item(std::move(item)) {}
+
+    const std::string &get_item() const { return item; }
+
+private:
+    std::string item;
+};
+
+// Why and where a plan is invalid.
+struct Violation {
+    long tick;
+    // The event that could not be executed, if any.
+    std::optional<AnyEvent> event;
+    // The offending item (or recipe, or technology), if any.
+    std::string item;
+    std::string message;
+};
+
+void to_json(nlohmann::json &j, const Violation &v);
+
+// Thrown by Simulation if the events are invalid.
+class SimulationError : public std::logic_error {
+public:
+    explicit SimulationError(Violation violation)
+        : std::logic_error(violation.message),
+          violation(std::move(violation)) {}
+
+    const Violation &get_violation() const { return violation; }
+
+private:
+    Violation violation;
+};
+
+// All classes in this namespace (and Order) allocate their working memory
+// from the given memory resource, e.g., an arena that is released at once
+// when a challenge is solved.
 class State {
 public:
-    State(const RecipeMap &all_recipes);
+    State(const RecipeMap &all_recipes,
+          std::pmr::memory_resource *resource
+          = std::pmr::get_default_resource());
 
     auto get_items() const { return items; }  // For debugging.
     int has_item(const std::string &name) const;
@@ -27,46 +77,246 @@ public:
                            const RecipeMap &recipe_map);
 
 private:
-    std::unordered_map<std::string, int> items;
+    PmrStringMap<int> items;
 
-    std::unordered_set<const Recipe *> unlocked_recipes;
-    std::unordered_set<const Technology *> unlocked_technologies;
+    std::pmr::unordered_set<const Recipe *> unlocked_recipes;
+    std::pmr::unordered_set<const Technology *> unlocked_technologies;
 };
 
 class Simulation {
 public:
+    // The events may be given in any order.
     Simulation(const RecipeMap &all_recipes, const FactoryMap &all_factories,
                const TechnologyMap &all_technologies, EventList events,
-               ItemList initial_items)
-        : state(all_recipes),
-          events(events.begin(), events.end()),
+               ItemList initial_items,
+               std::pmr::memory_resource *resource
+               = std::pmr::get_default_resource())
+        : resource(resource),
+          state(all_recipes, resource),
+          events(std::move(events)),
+          tick_events(resource),
+          slots(resource),
+          slot_of(resource),
+          waiting(resource),
+          ready(resource),
+          completions(resource),
+          recipe_table(resource),
+          recipe_ids(resource),
           all_recipes(all_recipes),
           all_factories(all_factories),
-          all_technologies(all_technologies) {
-        for (const auto &[name, amount] : initial_items) {
-            state.add_item(name, amount);
-        }
+          all_technologies(all_technologies),
+          initial_items(std::move(initial_items)) {
+        add_initial_items();
     }
 
+    // Replay the events produced by source, which must be sorted by
+    // timestamp. Only the events of the current tick are kept in memory, so
+    // arbitrarily long event logs can be simulated. simulate throws a
+    // SimulationError when an event is out of order.
+    Simulation(const RecipeMap &all_recipes, const FactoryMap &all_factories,
+               const TechnologyMap &all_technologies, EventSource &source,
+               ItemList initial_items,
+               std::pmr::memory_resource *resource
+               = std::pmr::get_default_resource())
+        : Simulation(all_recipes, all_factories, all_technologies, EventList(),
+                     std::move(initial_items), resource) {
+        this->source = &source;
+    }
+
+    // Throws a SimulationError for the first invalid event.
     long simulate();
 
+    // Like simulate, but returns the first violation instead of throwing, or
+    // std::nullopt if the plan is valid. Additionally, a plan is invalid if
+    // it deadlocks (no factory is active and no event is pending, but a
+    // factory still waits for ingredients or a goal item is missing), which
+    // ends the simulation right away, or if a goal item is missing at the
+    // victory tick.
+    std::optional<Violation> validate(const ItemCount &goal_items = {});
+
+    const State &get_state() const { return state; }
+
+    // Save the complete state of the simulation whenever at least interval
+    // ticks passed since the last checkpoint, so resimulate can resume from
+    // there. 0 (the default) disables checkpoints, and the events are moved
+    // out instead of copied. Has no effect on an EventSource. Must be set
+    // before the simulation starts.
+    void set_checkpoint_interval(long interval) {
+        checkpoint_interval = interval;
+    }
+
+    // Simulate events instead of the events given so far. The simulation
+    // resumes from the latest checkpoint before the first event (in execution
+    // order) that differs, so changing the tail of a long plan is cheap. If
+    // there is no such checkpoint, this is equivalent to a new Simulation.
+    // Throws std::logic_error for an EventSource.
+    long resimulate(EventList events);
+
 private:
+    using slot_t = std::uint32_t;
+
+    void add_initial_items();
+    // Move the VictoryEvent out of events into victory_tick, and sort the
+    // remaining events by execution order.
+    void prepare_events();
+    // Execute the events with the initial timestamp.
+    void initialize();
+    // Initialize, then run.
+    long start();
+    // Advance until the victory tick is reached.
+    long run();
+
+    // Throw a SimulationError at the current tick.
+    [[noreturn]] void fail(std::string message,
+                           const AnyEvent *event = nullptr,
+                           std::string item = {}) const;
+    // Call f, which executes e, and turn its exceptions into
+    // SimulationErrors.
+    template <class E, class F>
+    void execute(const E &e, F &&f);
+    // Returns the reason if nothing can happen anymore before the victory
+    // tick.
+    std::optional<Violation> find_deadlock();
+
     // Does nothing if "fid" is not a known factory.
     void cancel_recipe(FactoryIdMap::fid_t fid);
-    void build_factory(const BuildEvent *e, bool consume = true);
+    void build_factory(const BuildEvent &e, bool consume = true);
+    void destroy_factory(FactoryIdMap::fid_t fid);
+    void start_recipe(FactoryIdMap::fid_t fid, const Recipe &r);
 
+    // Ticks in which neither an event happens nor a factory finishes its
+    // recipe do not change the state, so they are skipped entirely.
+    long next_tick() const;
     void advance();
 
+    // Read the next event (other than a VictoryEvent) into lookahead.
+    void fetch();
+    // Like source->next(), but an invalid event is a SimulationError.
+    std::optional<AnyEvent> next_from_source();
+    // Move the events of the current tick into tick_events, sorted by
+    // execution order.
+    void gather_events();
+
+    // Recipes are referenced by a dense id, assigned on first use.
+    int get_recipe_id(const Recipe &r);
+
+    // A starved factory waits for one of the ingredients it lacks. It is only
+    // checked again (in step 10) once that ingredient was added.
+    void add_starved(slot_t slot);
+    void remove_starved(slot_t slot);
+    // Move the factories that wait for name to ready.
+    void wake(const std::string &name);
+    // Add items to the state, and wake the factories that wait for them.
+    void add_item(const std::string &name);
+    void add_items(const ItemCount &list);
+
+    // Min-heap of (finish tick, slot). Entries of cancelled recipes are not
+    // removed eagerly, but skipped once they reach the top.
+    using Completion = std::pair<long, slot_t>;
+    using CompletionQueue = std::priority_queue<Completion,
+                                                std::pmr::vector<Completion>,
+                                                std::greater<Completion>>;
+
+    bool is_pending(const Completion &c) const;
+
+    enum class Status : std::uint8_t { idle, active, starved, destroyed };
+
+    // State of every factory that was ever built, as parallel arrays indexed
+    // by slot. Slots are not reused after a DestroyEvent, so a slot refers to
+    // exactly one factory.
+    struct FactorySlots {
+        explicit FactorySlots(std::pmr::memory_resource *resource)
+            : fid(resource),
+              factory(resource),
+              status(resource),
+              recipe(resource),
+              finish_tick(resource),
+              wait_id(resource) {}
+
+        std::pmr::vector<FactoryIdMap::fid_t> fid;
+        std::pmr::vector<const Factory *> factory;
+        std::pmr::vector<Status> status;
+        std::pmr::vector<int> recipe;  // Recipe id, only if active or starved.
+        std::pmr::vector<long> finish_tick;  // Only if active.
+        // Changes whenever the factory becomes starved or stops being
+        // starved, which invalidates its old Waiters.
+        std::pmr::vector<std::uint32_t> wait_id;
+
+        slot_t add(FactoryIdMap::fid_t f, const Factory *fac) {
+            fid.push_back(f);
+            factory.push_back(fac);
+            status.push_back(Status::idle);
+            recipe.push_back(-1);
+            finish_tick.push_back(0);
+            wait_id.push_back(0);
+            return fid.size() - 1;
+        }
+    };
+
+    // A starved factory. Entries are not removed when the factory stops
+    // being starved, but skipped if their id is outdated.
+    struct Waiter {
+        slot_t slot;
+        std::uint32_t id;
+    };
+    using WaitList = PmrStringMap<std::pmr::vector<Waiter>>;
+
+    bool is_waiting(const Waiter &w) const;
+
     long tick = BuildEvent::initial;
+    std::pmr::memory_resource *resource;
     State state;
-    std::deque<std::shared_ptr<Event>> events;
-    std::unordered_map<FactoryIdMap::fid_t, Recipe> active_factories;
-    std::map<FactoryIdMap::fid_t, Recipe> starved_factories;
+    // Input: either events, which are sorted by execution order in simulate,
+    // or source.
+    EventList events;
+    std::size_t next_event = 0;
+    EventSource *source = nullptr;
+    // Timestamp of the last event read from source.
+    long source_tick = BuildEvent::initial;
+    // The next event that was not gathered yet.
+    std::optional<AnyEvent> lookahead;
+    std::pmr::vector<AnyEvent> tick_events;
+    std::optional<long> victory_tick;
+    FactorySlots slots;
+    // Slots of the factories that currently exist.
+    std::pmr::unordered_map<FactoryIdMap::fid_t, slot_t> slot_of;
+    // Starved factories by the ingredient they wait for.
+    WaitList waiting;
+    // Starved factories to check in the next step 10.
+    std::pmr::vector<Waiter> ready;
+    CompletionQueue completions;
     FactoryIdMap factory_id_map;
+    std::pmr::vector<const Recipe *> recipe_table;
+    std::pmr::unordered_map<const Recipe *, int> recipe_ids;
+
+    // Everything that changes while simulating, apart from the input events
+    // and the recipe ids, which stay valid. Checkpoints are dropped one by
+    // one, so their copies use the default memory resource.
+    struct Checkpoint {
+        long tick;
+        std::size_t next_event;  // The first event that was not gathered.
+        State state;
+        FactorySlots slots;
+        std::pmr::unordered_map<FactoryIdMap::fid_t, slot_t> slot_of;
+        WaitList waiting;
+        std::pmr::vector<Waiter> ready;
+        CompletionQueue completions;
+        FactoryIdMap factory_id_map;
+    };
+
+    void save_checkpoint();
+    void restore_checkpoint(const Checkpoint &c);
+
+    long checkpoint_interval = 0;
+    // Only set by validate.
+    const ItemCount *goal_items = nullptr;
+    // Sorted by tick.
+    std::vector<Checkpoint> checkpoints;
 
     const RecipeMap &all_recipes;
     const FactoryMap &all_factories;
     const TechnologyMap &all_technologies;
+    const ItemList initial_items;
 };
 
 }  // namespace game
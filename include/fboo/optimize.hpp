@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "entity.hpp"
+#include "event.hpp"
+#include "game.hpp"
+
+// Improves a plan (e.g., computed by Order) by local search. Random moves are
+// applied to the best plan so far: a recipe is started earlier, run on another
+// factory, or a technology is researched earlier. A candidate is evaluated by
+// simulating it, with its victory at its last event, and replaces the best
+// plan if all goal items exist at an earlier victory tick.
+class PlanOptimizer {
+public:
+    struct Options {
+        // Wall-clock time after which the best plan so far is returned.
+        std::chrono::milliseconds budget{1000};
+        // Number of threads evaluating candidates, 0 for one per core.
+        unsigned jobs = 0;
+        std::uint64_t seed = 1;
+    };
+
+    // initial_events are the BuildEvents of the initial factories, which are
+    // not part of the plans.
+    PlanOptimizer(const RecipeMap &all_recipes, const FactoryMap &all_factories,
+                  const TechnologyMap &all_technologies,
+                  EventList initial_events, const ItemList &initial_items,
+                  const ItemList &goal_items);
+
+    // Returns a plan that is at least as fast as plan, sorted by timestamp
+    // and ending with its VictoryEvent. If plan itself does not produce the
+    // goal items, it is returned unchanged. Only reads the entity maps, so
+    // multiple optimizers can run concurrently.
+    EventList optimize(EventList plan, const Options &options) const;
+
+private:
+    // Returns the victory tick of plan (without VictoryEvent), or
+    // std::nullopt if plan is invalid or does not produce the goal items.
+    std::optional<long> evaluate(game::Simulation &sim,
+                                 const EventList &plan) const;
+
+    const RecipeMap &all_recipes;
+    const FactoryMap &all_factories;
+    const TechnologyMap &all_technologies;
+    const EventList initial_events;
+    const ItemList initial_items;
+    ItemCount goal_items;
+};
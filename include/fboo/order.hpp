@@ -1,27 +1,59 @@
 #pragma once
 
-#include <set>
+#include <memory_resource>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "cost.hpp"
 #include "entity.hpp"
 #include "event.hpp"
 #include "game.hpp"
+#include "util.hpp"
 
+// Order (and game::State) only read the entity maps, so multiple Orders can
+// compute solutions concurrently on the same maps. All working memory is
+// allocated from resource.
 class Order {
 public:
+    enum class Schedule {
+        // Execute one recipe after the other.
+        serial,
+        // Execute recipes as early as their ingredients, their factory, and
+        // their technology allow, so recipes run in parallel on different
+        // factories.
+        concurrent,
+    };
+
     Order(const RecipeMap &all_recipes, const FactoryMap &all_factories,
-          const TechnologyMap &all_technologies,
+          const TechnologyMap &all_technologies, const EntityIndex &index,
           const std::unordered_map<FactoryIdMap::fid_t, const Factory *>
               &initial_factories,
-          const ItemList &initial_items, const ItemList &goal_items)
+          const ItemList &initial_items, const ItemList &goal_items,
+          Schedule schedule = Schedule::serial,
+          const CostModel *costs = nullptr,
+          std::pmr::memory_resource *resource
+          = std::pmr::get_default_resource())
         : all_recipes(all_recipes),
           all_factories(all_factories),
           all_technologies(all_technologies),
+          index(index),
           goal_items(goal_items),
+          schedule(schedule),
+          costs(costs),
+          resource(resource),
           tick(0),
-          state(all_recipes) {
+          factory_free_tick(resource),
+          item_ready_tick(index.get_item_count(), 0, resource),
+          recipe_unlock_tick(resource),
+          research_tick(resource),
+          craftable_categories(resource),
+          state(all_recipes, resource),
+          order(resource),
+          visited(index.get_item_count(), false, resource),
+          creatable_items(index.get_item_count(), nullptr, resource),
+          infeasible(index.get_item_count(), resource) {
         for (const auto &[name, amount] : initial_items) {
             state.add_item(name, amount);
         }
@@ -30,39 +62,86 @@ public:
         }
     }
 
+    // Pass the events of the solution to sink as soon as they are planned.
+    // With Schedule::concurrent, events are planned out of order, so they are
+    // buffered and sorted before being passed on.
+    void compute(EventSink &sink);
     EventList compute();
 
 private:
     bool is_factory_available(const Recipe &r);
+    void emit(AnyEvent e);
 
     FactoryIdMap::fid_t add_factory(const Factory &f, FactoryIdMap::fid_t fid);
     FactoryIdMap::fid_t add_factory(const Factory &f);
     void add_technology(const Technology &t);
     void add_recipe(const Recipe &r, int amount);
+    void schedule_serial(const Recipe &r, int amount);
+    void schedule_concurrent(const Recipe &r, int amount);
+
+    // For Schedule::concurrent: the tick from which on all items of the given
+    // kind that were planned so far are available.
+    long ready_tick(const std::string &item) const;
+    long ready_tick(const ItemCount &items) const;
 
     bool craft_recipe(const Recipe &r, const std::string &name, int amount,
-                      std::set<std::string> visited, bool dry_run);
+                      bool dry_run);
     bool create_item(const std::string &name, int amount,
-                     std::set<std::string> visited = {}, bool dry_run = false);
-    bool create_factory(const std::string &category,
-                        std::set<std::string> visited, bool dry_run);
-    bool create_technology(const Recipe &r, std::set<std::string> visited,
-                           bool dry_run);
-    bool create_technology(const Technology &t, std::set<std::string> visited,
-                           bool dry_run);
+                     bool dry_run = false);
+    bool create_factory(const std::string &category, bool dry_run);
+    bool create_technology(const Recipe &r, bool dry_run);
+    bool create_technology(const Technology &t, bool dry_run);
+
+    // Must be called whenever the state changes in a way that could make an
+    // item creatable that was not creatable before.
+    void invalidate_infeasible() { ++generation; }
+    void set_creatable(const std::string &name, const Recipe &r);
 
     const RecipeMap &all_recipes;
     const FactoryMap &all_factories;
     const TechnologyMap &all_technologies;
+    const EntityIndex &index;
     const ItemList &goal_items;
+    const Schedule schedule;
+    // If set, the recipes for an item are tried from cheapest to most
+    // expensive.
+    const CostModel *costs;
+    std::pmr::memory_resource *resource;
 
-    long tick;
-    std::unordered_set<std::string> craftable_categories;
-    std::unordered_set<std::string> craftable_items;
+    long tick;  // Only used for Schedule::serial.
+    // Only used for Schedule::concurrent.
+    std::pmr::unordered_map<FactoryIdMap::fid_t, long> factory_free_tick;
+    // Indexed by item id.
+    std::pmr::vector<long> item_ready_tick;
+    std::pmr::unordered_map<const Recipe *, long> recipe_unlock_tick;
+    std::pmr::unordered_map<const Technology *, long> research_tick;
+    PmrStringSet craftable_categories;
     game::State state;
     FactoryIdMap fid_map;
-    EventList order;
+    EventSink *sink = nullptr;
+    // Only used for Schedule::concurrent.
+    std::pmr::vector<AnyEvent> order;
+    long last_timestamp = 0;  // Of the last event passed to sink.
+
+    // Items on the current path of the recursion (indexed by item id), to
+    // avoid dependency-cycles.
+    std::pmr::vector<bool> visited;
+    // Number of times the recursion was cut off because of visited. Results
+    // that depend on a cut-off also depend on the path, so they are not
+    // memoized.
+    long cycle_cuts = 0;
+
+    // Memoization: the recipe that creates an item (indexed by item id), or
+    // nullptr.
+    std::pmr::vector<const Recipe *> creatable_items;
 
-    // Memoization
-    std::unordered_map<std::string, const Recipe *> creatable_items;
+    // For every item id: the smallest (missing) amount for which create_item
+    // failed, valid as long as generation did not change since then. Failing
+    // for some amount implies failing for every larger amount.
+    struct Infeasible {
+        long generation = -1;
+        int amount = 0;
+    };
+    long generation = 0;
+    std::pmr::vector<Infeasible> infeasible;
 };
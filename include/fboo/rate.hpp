@@ -0,0 +1,50 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "entity.hpp"
+
+// Steady-state production planning: how many factories of which type have to
+// run which recipe to continuously produce items at the requested rates?
+// Recipes with by-products (and cycles) are handled by solving a linear
+// program over the executions per second of every relevant recipe.
+class RateSolver {
+public:
+    static constexpr double ticks_per_second = 60;
+
+    // Items per second.
+    using RateMap = std::unordered_map<std::string, double>;
+
+    struct RecipeRate {
+        const Recipe *recipe;
+        const Factory *factory;
+        double executions;  // Per second.
+        double factories;   // Number of factories that are busy all the time.
+    };
+
+    struct Result {
+        std::vector<RecipeRate> recipes;  // Sorted by recipe name.
+        RateMap surplus;  // By-products beyond the requested rates.
+    };
+
+    RateSolver(const RecipeMap &all_recipes, const FactoryMap &all_factories,
+               const EntityIndex &index)
+        : all_recipes(all_recipes), all_factories(all_factories), index(index) {}
+
+    // Minimize the total number of factories. Throws std::invalid_argument if
+    // some item cannot be produced.
+    Result solve(const RateMap &rates) const;
+
+    // The factory used for r: the fastest one that can be built, or the
+    // fastest one at all if none can be built (e.g., the player).
+    const Factory *choose_factory(const Recipe &r) const;
+
+private:
+    const RecipeMap &all_recipes;
+    const FactoryMap &all_factories;
+    const EntityIndex &index;
+};
+
+void to_json(nlohmann::json &j, const RateSolver::Result &r);
@@ -0,0 +1,133 @@
+#pragma once
+#include <nlohmann/json.hpp>
+
+#ifdef FBOO_STATS
+#include <array>
+#include <chrono>
+#include <cstddef>
+#endif
+
+// Profiling counters for Order and game::Simulation. They are only compiled
+// in if FBOO_STATS is defined (cmake -DFBOO_STATS=ON), otherwise all FBOO_*
+// macros below expand to nothing.
+namespace stats {
+
+#ifdef FBOO_STATS
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// The steps of game::Simulation::advance, in order.
+enum class Step {
+    tick,
+    gather,
+    finish,
+    research,
+    stop,
+    destroy,
+    victory,
+    build,
+    start,
+    starved,
+    count,
+};
+
+enum class Counter {
+    // game::Simulation
+    simulate_ns,
+    advance,
+    events,
+    recipes_finished,
+    recipes_started,
+    starved_checks,
+    checkpoint_restored,
+    // Order
+    compute_ns,
+    create_item,
+    craft_recipe,
+    dry_run,
+    memo_hit,
+    infeasible_hit,
+    cycle_cut,
+    create_factory,
+    create_technology,
+    // PlanOptimizer
+    optimize_candidate,
+    optimize_improvement,
+    count,
+};
+
+// All counters as json, summed over all threads that have exited and the
+// calling thread. Everything is 0 if stats are not enabled.
+nlohmann::json report();
+// Set all counters of exited threads and the calling thread to 0.
+void reset();
+
+#ifdef FBOO_STATS
+struct Counters {
+    std::array<long, std::size_t(Counter::count)> counts{};
+    std::array<long, std::size_t(Step::count)> step_calls{};
+    std::array<long, std::size_t(Step::count)> step_ns{};
+
+    Counters &operator+=(const Counters &other);
+};
+
+// Every thread counts on its own, and adds its counts to the global ones when
+// it exits.
+struct LocalCounters : Counters {
+    ~LocalCounters();
+};
+
+inline thread_local LocalCounters local;
+
+using Clock = std::chrono::steady_clock;
+
+inline long elapsed_ns(Clock::time_point since, Clock::time_point now) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now - since)
+        .count();
+}
+
+inline void count(Counter c, long n = 1) {
+    local.counts[std::size_t(c)] += n;
+}
+
+// Attributes the time since the previous lap (or construction) to a step.
+class StepTimer {
+public:
+    void lap(Step s) {
+        auto now = Clock::now();
+        local.step_ns[std::size_t(s)] += elapsed_ns(last, now);
+        ++local.step_calls[std::size_t(s)];
+        last = now;
+    }
+
+private:
+    Clock::time_point last = Clock::now();
+};
+
+// Adds the lifetime of the timer to a counter.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Counter c) : c(c) {}
+    ~ScopedTimer() { count(c, elapsed_ns(start, Clock::now())); }
+
+private:
+    Counter c;
+    Clock::time_point start = Clock::now();
+};
+
+#define FBOO_COUNT(c) ::stats::count(::stats::Counter::c)
+#define FBOO_COUNT_N(c, n) ::stats::count(::stats::Counter::c, (n))
+#define FBOO_TIME(c) ::stats::ScopedTimer fboo_timer_##c(::stats::Counter::c)
+#define FBOO_STEP_TIMER(t) ::stats::StepTimer t
+#define FBOO_STEP(t, s) (t).lap(::stats::Step::s)
+#else
+#define FBOO_COUNT(c) ((void)0)
+#define FBOO_COUNT_N(c, n) ((void)0)
+#define FBOO_TIME(c) ((void)0)
+#define FBOO_STEP_TIMER(t) ((void)0)
+#define FBOO_STEP(t, s) ((void)0)
+#endif
+
+}  // namespace stats
@@ -1,10 +1,14 @@
 #pragma once
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <ostream>
 #include <ranges>
 #include <set>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -12,6 +16,29 @@
 class Entity;
 class Event;
 
+// Hash and equality for string keys that allow lookups with any kind of string
+// (heterogeneous lookup), so no key has to be constructed for them. The
+// pmr-containers below keep their keys in their memory resource.
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+struct StringEqual {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const {
+        return a == b;
+    }
+};
+
+template <class T>
+using PmrStringMap = std::pmr::unordered_map<std::pmr::string, T, StringHash,
+                                             StringEqual>;
+using PmrStringSet
+    = std::pmr::unordered_set<std::pmr::string, StringHash, StringEqual>;
+
 template <class T>
 requires requires(T t) {
     { t.to_string() } -> std::same_as<std::string>;
@@ -100,30 +127,3 @@ std::ostream &operator<<(std::ostream &os, const S &s) {
     os << "}";
     return os;
 }
-
-template <class Subclass, std::ranges::range It>
-requires is_specialization<typename It::value_type, std::shared_ptr>
-      || is_specialization<typename It::value_type, std::unique_ptr>
-auto extract_subclass(const It &it) {
-    return it | std::views::transform([](const auto &e) {
-               return dynamic_cast<const Subclass *>(e.get());
-           })
-           | std::views::filter([](const auto *e) { return e; });
-}
-
-template <class Subclass, std::ranges::range It>
-requires std::derived_from<Subclass,
-                           std::remove_pointer_t<typename It::value_type>>
-auto extract_subclass(const It &it) {
-    return it | std::views::transform([](const auto &e) {
-               return dynamic_cast<const Subclass *>(e);
-           })
-           | std::views::filter([](const auto *e) { return e; });
-}
-
-template <class T, class U>
-const T *cast(const U *u) {
-    return dynamic_cast<const T *>(u);
-}
-template <class T>
-constexpr auto cast_event = cast<T, Event>;
@@ -0,0 +1,180 @@
+#include "bom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ranges>
+
+BomSolver::BomSolver(const EntityIndex &index, const CostModel &costs)
+    : index(index),
+      recipe_of(index.get_item_count(), nullptr),
+      factory_of(index.get_item_count(), nullptr) {
+    // The producible recipes of every item, cheapest first.
+    const int n = index.get_item_count();
+    std::vector<std::vector<const Recipe *>> options(n);
+    for (int id = 0; id < n; ++id) {
+        const std::string &name = index.get_item_name(id);
+        for (const Recipe *r : index.get_producers(name)) {
+            if (std::isfinite(costs.get_recipe_cost(*r, name))) {
+                options[id].push_back(r);
+            }
+        }
+        std::ranges::stable_sort(options[id], {}, [&](const Recipe *r) {
+            return costs.get_recipe_cost(*r, name);
+        });
+    }
+
+    // Depth-first post-order puts ingredients before their products, so the
+    // reverse is the order we need. Every item uses its cheapest recipe that
+    // does not close a cycle (e.g., a burner that mines its own fuel).
+    enum class Mark : std::uint8_t { none, active, done };
+    std::vector<Mark> marks(n, Mark::none);
+    auto visit = [&](auto &self, int id) -> void {
+        marks[id] = Mark::active;
+        for (const Recipe *r : options[id]) {
+            if (std::ranges::none_of(r->get_ingredients(), [&](const auto &i) {
+                    return marks[index.get_item_id(i.first)] == Mark::active;
+                })) {
+                recipe_of[id] = r;
+                break;
+            }
+        }
+        if (const Recipe *r = recipe_of[id]) {
+            for (const Factory *f : index.get_factories(r->get_category())) {
+                if (!factory_of[id]
+                    || f->get_crafting_speed()
+                           > factory_of[id]->get_crafting_speed()) {
+                    factory_of[id] = f;
+                }
+            }
+            for (const auto &[name, _] : r->get_ingredients()) {
+                int ing = index.get_item_id(name);
+                if (marks[ing] == Mark::none) {
+                    self(self, ing);
+                }
+            }
+        }
+        marks[id] = Mark::done;
+        order.push_back(id);
+    };
+    for (int id = 0; id < n; ++id) {
+        if (marks[id] == Mark::none) {
+            visit(visit, id);
+        }
+    }
+    std::ranges::reverse(order);
+}
+
+BomSolver::Result BomSolver::solve(const ItemList &goal_items,
+                                   const ItemList &initial_items) const {
+    Result result;
+    const std::size_t n = order.size();
+    std::vector<long> demand(n), available(n), spare(n), path(n);
+    std::vector<bool> crafted(n);
+    for (const auto &[name, amount] : initial_items) {
+        if (int id = index.get_item_id(name); id >= 0) {
+            available[id] += amount;
+        }
+    }
+    for (const auto &[name, amount] : goal_items) {
+        int id = index.get_item_id(name);
+        if (id < 0) {
+            result.missing[name] += amount;
+        } else {
+            demand[id] += amount;
+        }
+    }
+
+    // Every item is handled after all of its consumers, so its demand is
+    // complete and rounded only once.
+    for (int id : order) {
+        long need = demand[id];
+        if (need <= 0) {
+            continue;
+        }
+        const std::string &name = index.get_item_name(id);
+        long used = std::min(need, available[id]);
+        if (used > 0) {
+            result.initial_items_used[name] += used;
+            available[id] -= used;
+            need -= used;
+        }
+        used = std::min(need, spare[id]);
+        spare[id] -= used;
+        need -= used;
+        if (need == 0) {
+            continue;
+        }
+
+        const Recipe *r = recipe_of[id];
+        if (!r) {
+            result.missing[name] += need;
+            continue;
+        }
+        int executions = calc_execution_times(*r, name, int(need));
+        for (const auto &[product, amount] : r->get_products()) {
+            int p = index.get_item_id(product);
+            spare[p] += static_cast<long>(executions) * amount;
+        }
+        spare[id] -= need;
+        for (const auto &[ingredient, _] : r->get_ingredients()) {
+            demand[index.get_item_id(ingredient)]
+                += calc_ingredient_amount(*r, name, int(need), ingredient);
+        }
+        if (r->get_ingredients().empty()) {
+            result.raw[name] += need;
+        } else {
+            result.intermediates[name] += need;
+        }
+
+        long ticks = factory_of[id]->calc_ticks(*r);
+        result.recipes.push_back(
+            {r, factory_of[id], executions, executions * ticks});
+        result.total_ticks += executions * ticks;
+        crafted[id] = true;
+    }
+
+    // Ingredients come after their products in order.
+    for (int id : order | std::views::reverse) {
+        if (!crafted[id]) {
+            continue;
+        }
+        const Recipe *r = recipe_of[id];
+        long longest = 0;
+        for (const auto &[ingredient, _] : r->get_ingredients()) {
+            longest = std::max(longest, path[index.get_item_id(ingredient)]);
+        }
+        path[id] = longest + factory_of[id]->calc_ticks(*r);
+    }
+    for (const auto &[name, _] : goal_items) {
+        if (int id = index.get_item_id(name); id >= 0) {
+            result.critical_path_ticks
+                = std::max(result.critical_path_ticks, path[id]);
+        }
+    }
+
+    for (std::size_t id = 0; id < n; ++id) {
+        if (spare[id] > 0) {
+            result.surplus[index.get_item_name(id)] = spare[id];
+        }
+    }
+    std::ranges::reverse(result.recipes);
+    return result;
+}
+
+void to_json(nlohmann::json &j, const BomSolver::Result &r) {
+    j = nlohmann::json{{"raw", r.raw},
+                       {"intermediates", r.intermediates},
+                       {"initial-items-used", r.initial_items_used},
+                       {"missing", r.missing},
+                       {"surplus", r.surplus},
+                       {"total-ticks", r.total_ticks},
+                       {"critical-path-ticks", r.critical_path_ticks}};
+    j["recipes"] = nlohmann::json::array();
+    for (const auto &c : r.recipes) {
+        j["recipes"].push_back({{"recipe", c.recipe->get_name()},
+                                {"factory", c.factory->get_name()},
+                                {"executions", c.executions},
+                                {"ticks", c.ticks}});
+    }
+}
@@ -0,0 +1,122 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+PlanCache::PlanCache(std::filesystem::path dir) : dir(std::move(dir)) {
+    std::filesystem::create_directories(this->dir);
+}
+
+std::uint64_t PlanCache::hash(std::string_view data, std::uint64_t h) {
+    for (char c : data) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+std::uint64_t PlanCache::hash_files(
+    const std::vector<std::filesystem::path> &paths) {
+    std::uint64_t h = hash({});
+    for (const auto &path : paths) {
+        std::ifstream is(path, std::ios::binary);
+        if (!is) {
+            throw std::runtime_error("cannot open " + path.string());
+        }
+        std::string data(std::istreambuf_iterator<char>(is), {});
+        h = hash(data, h);
+    }
+    return h;
+}
+
+namespace {
+
+// Merge the amounts of equal items and sort them by name, since neither
+// changes the challenge.
+nlohmann::json canonical_items(const nlohmann::json &items) {
+    std::map<std::string, long> merged;
+    for (const auto &item : items) {
+        merged[item.at("name").get<std::string>()] +=
+            item.at("amount").get<long>();
+    }
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto &[name, amount] : merged) {
+        result.push_back({{"name", name}, {"amount", amount}});
+    }
+    return result;
+}
+
+}  // namespace
+
+std::string PlanCache::challenge_key(const nlohmann::json &target) {
+    nlohmann::json factories = target.at("initial-factories");
+    std::sort(factories.begin(), factories.end(),
+              [](const nlohmann::json &a, const nlohmann::json &b) {
+                  return a.at("factory-id") < b.at("factory-id");
+              });
+    return nlohmann::json{
+        {"initial-items", canonical_items(target.at("initial-items"))},
+        {"initial-factories", factories},
+        {"goal-items", canonical_items(target.at("goal-items"))}}
+        .dump();
+}
+
+std::filesystem::path PlanCache::path_of(const std::string &key) const {
+    std::ostringstream name;
+    name << std::hex << hash(key) << ".json";
+    return dir / name.str();
+}
+
+std::optional<PlanCache::Entry> PlanCache::find(
+    const std::string &key, const RecipeMap &recipes,
+    const FactoryMap &factories, const TechnologyMap &technologies) const {
+    std::ifstream is(path_of(key));
+    if (!is) {
+        return std::nullopt;
+    }
+    try {
+        nlohmann::json j = nlohmann::json::parse(is);
+        // The full key is stored to rule out hash collisions.
+        if (j.at("key") != key) {
+            return std::nullopt;
+        }
+        Entry entry;
+        for (const auto &e : j.at("events")) {
+            entry.events.push_back(
+                event_from_json(e, recipes, factories, technologies));
+        }
+        if (j.contains("tick")) {
+            entry.tick = j["tick"].get<long>();
+        }
+        return entry;
+    } catch (const std::exception &) {
+        // E.g., written by an incompatible version.
+        return std::nullopt;
+    }
+}
+
+void PlanCache::store(const std::string &key, const Entry &entry) const {
+    nlohmann::json j{{"key", key}, {"events", entry.events}};
+    if (entry.tick) {
+        j["tick"] = *entry.tick;
+    }
+
+    // Write to a temporary file with a random name first, so readers never
+    // see a partial entry.
+    std::filesystem::path path = path_of(key);
+    std::filesystem::path tmp = path;
+    tmp += ".tmp" + std::to_string(std::random_device()());
+    {
+        std::ofstream os(tmp);
+        os << j;
+        if (!os) {
+            throw std::runtime_error("cannot write " + tmp.string());
+        }
+    }
+    std::filesystem::rename(tmp, path);
+}
@@ -0,0 +1,559 @@
+#include "catalog.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.hpp"
+
+using json = nlohmann::json;
+
+namespace catalog {
+
+Entities load_json(const std::string &item_path,
+                   const std::string &recipe_path,
+                   const std::string &factory_path,
+                   const std::string &technology_path) {
+    json item;
+    std::ifstream(item_path) >> item;
+    ItemMap items;
+    for (const auto &[name, val] : item.items()) {
+        items.emplace(std::piecewise_construct, std::forward_as_tuple(name),
+                      std::forward_as_tuple(name, val["type"]));
+    }
+
+    json recipe;
+    std::ifstream(recipe_path) >> recipe;
+    RecipeMap recipes;
+    for (const auto &[name, val] : recipe.items()) {
+        recipes.emplace(
+            std::piecewise_construct, std::forward_as_tuple(name),
+            std::forward_as_tuple(name, val["category"], val["energy"],
+                                  val["enabled"], val["ingredients"],
+                                  val["products"]));
+    }
+
+    json factory;
+    std::ifstream(factory_path) >> factory;
+    FactoryMap factories;
+    for (const auto &[name, val] : factory.items()) {
+        factories.emplace(std::piecewise_construct, std::forward_as_tuple(name),
+                          std::forward_as_tuple(name, val["crafting_speed"],
+                                                val["crafting_categories"]));
+    }
+
+    json technology;
+    std::ifstream(technology_path) >> technology;
+    TechnologyMap technologies;
+    for (const auto &[name, val] : technology.items()) {
+        std::vector<std::string> unlocked_recipes;
+        for (const auto &e : val["effects"]) {
+            if (e["type"] != "unlock-recipe") {
+                throw std::invalid_argument("invalid field in " + name + ": "
+                                            + e.dump());
+            }
+            unlocked_recipes.push_back(e["recipe"]);
+        }
+
+        technologies.emplace(
+            std::piecewise_construct, std::forward_as_tuple(name),
+            std::forward_as_tuple(name, val["prerequisites"],
+                                  val["ingredients"], unlocked_recipes));
+    }
+
+    return {items, recipes, factories, technologies};
+}
+
+namespace {
+
+// Collects the contents of all sections before they are written.
+class Writer {
+public:
+    format::Str str(const std::string &s) {
+        auto [it, inserted] = interned.try_emplace(s);
+        if (inserted) {
+            it->second = {static_cast<std::uint32_t>(strings.size()),
+                          static_cast<std::uint32_t>(s.size())};
+            strings.insert(strings.end(), s.begin(), s.end());
+        }
+        return it->second;
+    }
+
+    // Lists keep the order of the json-files, since that order determines
+    // the iteration order of the entity maps created from them.
+    format::Range amount_list(const json &j) {
+        format::Range r{static_cast<std::uint32_t>(amounts.size()), 0};
+        for (const auto &a : j) {
+            amounts.push_back({str(a["name"]), a["amount"]});
+            ++r.count;
+        }
+        return r;
+    }
+
+    format::Range name_list(const std::vector<std::string> &v) {
+        format::Range r{static_cast<std::uint32_t>(names.size()), 0};
+        for (const std::string &s : v) {
+            names.push_back(str(s));
+            ++r.count;
+        }
+        return r;
+    }
+
+    std::vector<format::Item> items;
+    std::vector<format::Recipe> recipes;
+    std::vector<format::Factory> factories;
+    std::vector<format::Technology> technologies;
+    std::vector<format::Amount> amounts;
+    std::vector<format::Str> names;
+    std::vector<char> strings;
+
+private:
+    std::unordered_map<std::string, format::Str> interned;
+};
+
+constexpr std::uint64_t align(std::uint64_t offset) {
+    return (offset + 7) & ~std::uint64_t{7};
+}
+
+Writer read_json(const std::string &item_path, const std::string &recipe_path,
+                 const std::string &factory_path,
+                 const std::string &technology_path) {
+    json item, recipe, factory, technology;
+    std::ifstream(item_path) >> item;
+    std::ifstream(recipe_path) >> recipe;
+    std::ifstream(factory_path) >> factory;
+    std::ifstream(technology_path) >> technology;
+
+    // Objects are iterated in sorted order, so every table is sorted by name.
+    Writer w;
+    for (const auto &[name, val] : item.items()) {
+        w.items.push_back({w.str(name), w.str(val["type"])});
+    }
+    for (const auto &[name, val] : recipe.items()) {
+        w.recipes.push_back({w.str(name), w.str(val["category"]),
+                             val["energy"], val["enabled"].get<bool>(),
+                             w.amount_list(val["ingredients"]),
+                             w.amount_list(val["products"])});
+    }
+    for (const auto &[name, val] : factory.items()) {
+        w.factories.push_back({w.str(name), val["crafting_speed"],
+                               w.name_list(val["crafting_categories"])});
+    }
+    for (const auto &[name, val] : technology.items()) {
+        std::vector<std::string> unlocked_recipes;
+        for (const auto &e : val["effects"]) {
+            if (e["type"] != "unlock-recipe") {
+                throw std::invalid_argument("invalid field in " + name + ": "
+                                            + e.dump());
+            }
+            unlocked_recipes.push_back(e["recipe"]);
+        }
+        w.technologies.push_back({w.str(name),
+                                  w.name_list(val["prerequisites"]),
+                                  w.amount_list(val["ingredients"]),
+                                  w.name_list(unlocked_recipes)});
+    }
+    return w;
+}
+
+}  // namespace
+
+std::uint64_t hash_json(const std::string &item_path,
+                        const std::string &recipe_path,
+                        const std::string &factory_path,
+                        const std::string &technology_path) {
+    return PlanCache::hash_files(
+        {item_path, recipe_path, factory_path, technology_path});
+}
+
+void write_binary(std::ostream &os, const std::string &item_path,
+                  const std::string &recipe_path,
+                  const std::string &factory_path,
+                  const std::string &technology_path) {
+    Writer w = read_json(item_path, recipe_path, factory_path, technology_path);
+
+    format::Header h{};
+    std::memcpy(h.magic, format::magic, sizeof(h.magic));
+    h.version = format::version;
+    h.source_hash
+        = hash_json(item_path, recipe_path, factory_path, technology_path);
+
+    std::uint64_t offset = sizeof(h);
+    auto place = [&](format::Section &s, const auto &v) {
+        offset = align(offset);
+        s = {offset, v.size()};
+        offset += v.size() * sizeof(v[0]);
+    };
+    place(h.items, w.items);
+    place(h.recipes, w.recipes);
+    place(h.factories, w.factories);
+    place(h.technologies, w.technologies);
+    place(h.amounts, w.amounts);
+    place(h.names, w.names);
+    place(h.strings, w.strings);
+    h.file_size = offset;
+
+    std::uint64_t written = 0;
+    auto emit = [&](const format::Section &s, const auto *data,
+                    std::size_t bytes) {
+        static constexpr char padding[8] = {};
+        os.write(padding, s.offset - written);
+        os.write(reinterpret_cast<const char *>(data), bytes);
+        written = s.offset + bytes;
+    };
+    auto emit_vector = [&](const format::Section &s, const auto &v) {
+        emit(s, v.data(), v.size() * sizeof(v[0]));
+    };
+    emit({0, 1}, &h, sizeof(h));
+    emit_vector(h.items, w.items);
+    emit_vector(h.recipes, w.recipes);
+    emit_vector(h.factories, w.factories);
+    emit_vector(h.technologies, w.technologies);
+    emit_vector(h.amounts, w.amounts);
+    emit_vector(h.names, w.names);
+    emit_vector(h.strings, w.strings);
+
+    if (!os) {
+        throw std::runtime_error("could not write catalog");
+    }
+}
+
+namespace {
+
+std::ostream &operator<<(std::ostream &os, const format::Str &s) {
+    return os << '{' << s.offset << ", " << s.length << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Range &r) {
+    return os << '{' << r.begin << ", " << r.count << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Amount &a) {
+    return os << '{' << a.name << ", " << a.amount << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Item &i) {
+    return os << '{' << i.name << ", " << i.type << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Recipe &r) {
+    return os << '{' << r.name << ", " << r.category << ", "
+              << r.required_energy << ", " << r.enabled << ", "
+              << r.ingredients << ", " << r.products << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Factory &f) {
+    return os << '{' << f.name << ", " << f.crafting_speed << ", "
+              << f.crafting_categories << '}';
+}
+
+std::ostream &operator<<(std::ostream &os, const format::Technology &t) {
+    return os << '{' << t.name << ", " << t.prerequisites << ", "
+              << t.ingredients << ", " << t.unlocked_recipes << '}';
+}
+
+// Write v as a constexpr std::array, one element per line.
+template <class T>
+void write_array(std::ostream &os, std::string_view type,
+                 std::string_view name, const std::vector<T> &v) {
+    os << "constexpr std::array<format::" << type << ", " << v.size() << "> "
+       << name << " = {{\n";
+    for (const T &e : v) {
+        os << "    " << e << ",\n";
+    }
+    os << "}};\n\n";
+}
+
+}  // namespace
+
+void write_cpp(std::ostream &os, const std::string &item_path,
+               const std::string &recipe_path,
+               const std::string &factory_path,
+               const std::string &technology_path) {
+    Writer w = read_json(item_path, recipe_path, factory_path, technology_path);
+
+    os << "// Generated by fboo-catalog, do not edit.\n"
+          "#include <array>\n\n"
+          "#include \"fboo/catalog.hpp\"\n\n"
+          "namespace catalog {\n\n"
+          "namespace {\n\n";
+    // Crafting speeds have to survive the round trip exactly.
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    write_array(os, "Item", "items", w.items);
+    write_array(os, "Recipe", "recipes", w.recipes);
+    write_array(os, "Factory", "factories", w.factories);
+    write_array(os, "Technology", "technologies", w.technologies);
+    write_array(os, "Amount", "amounts", w.amounts);
+    write_array(os, "Str", "names", w.names);
+
+    // Split into lines of adjacent literals. Octal escapes (unlike hex ones)
+    // end after at most three digits.
+    os << "constexpr char strings[] =";
+    for (std::size_t i = 0; i < w.strings.size(); ++i) {
+        if (i % 64 == 0) {
+            os << "\n    \"";
+        }
+        unsigned char c = w.strings[i];
+        if (c == '"' || c == '\\' || c < ' ' || c > '~') {
+            os << '\\' << std::oct << std::setw(3) << std::setfill('0')
+               << unsigned(c) << std::dec << std::setfill(' ');
+        } else {
+            os << c;
+        }
+        if (i % 64 == 63 || i + 1 == w.strings.size()) {
+            os << '"';
+        }
+    }
+    if (w.strings.empty()) {
+        os << " \"\"";
+    }
+    os << ";\n\n";
+
+    os << "constexpr format::Tables tables = {\n"
+          "    items, recipes, factories, technologies, amounts, names,\n"
+          "    {strings, " << w.strings.size() << "}};\n\n"
+          "}  // namespace\n\n"
+          "const format::Tables &embedded_tables() { return tables; }\n\n"
+          "}  // namespace catalog\n";
+
+    if (!os) {
+        throw std::runtime_error("could not write catalog");
+    }
+}
+
+namespace {
+
+// Whether every Str and Range in the tables lies within its section, so the
+// views never read outside of the catalog.
+bool slices_fit(const format::Tables &t) {
+    auto str = [&](const format::Str &s) {
+        return s.offset <= t.strings.size()
+            && s.length <= t.strings.size() - s.offset;
+    };
+    auto fits = [](const format::Range &r, std::size_t size) {
+        return r.begin <= size && r.count <= size - r.begin;
+    };
+    auto amounts = [&](const format::Range &r) {
+        return fits(r, t.amounts.size());
+    };
+    auto names = [&](const format::Range &r) {
+        return fits(r, t.names.size());
+    };
+    return std::ranges::all_of(t.items, [&](const format::Item &i) {
+               return str(i.name) && str(i.type);
+           })
+        && std::ranges::all_of(t.recipes, [&](const format::Recipe &r) {
+               return str(r.name) && str(r.category)
+                   && amounts(r.ingredients) && amounts(r.products);
+           })
+        && std::ranges::all_of(t.factories, [&](const format::Factory &f) {
+               return str(f.name) && names(f.crafting_categories);
+           })
+        && std::ranges::all_of(
+               t.technologies, [&](const format::Technology &te) {
+                   return str(te.name) && names(te.prerequisites)
+                       && amounts(te.ingredients)
+                       && names(te.unlocked_recipes);
+               })
+        && std::ranges::all_of(t.amounts, [&](const format::Amount &a) {
+               return str(a.name);
+           })
+        && std::ranges::all_of(t.names, str);
+}
+
+}  // namespace
+
+Catalog::Catalog(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("could not open catalog " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("could not stat catalog " + path);
+    }
+    size = st.st_size;
+    if (size < sizeof(format::Header)) {
+        close(fd);
+        throw std::runtime_error("catalog " + path + " is truncated");
+    }
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("could not map catalog " + path);
+    }
+    data = static_cast<const std::byte *>(p);
+    const auto *header = reinterpret_cast<const format::Header *>(data);
+
+    auto fits = [&](const format::Section &s, std::size_t elem_size) {
+        return s.offset % alignof(std::uint64_t) == 0 && s.offset <= size
+            && s.count <= (size - s.offset) / elem_size;
+    };
+    if (std::memcmp(header->magic, format::magic, sizeof(format::magic))
+            != 0
+        || header->version != format::version || header->file_size != size
+        || !fits(header->items, sizeof(format::Item))
+        || !fits(header->recipes, sizeof(format::Recipe))
+        || !fits(header->factories, sizeof(format::Factory))
+        || !fits(header->technologies, sizeof(format::Technology))
+        || !fits(header->amounts, sizeof(format::Amount))
+        || !fits(header->names, sizeof(format::Str))
+        || !fits(header->strings, 1)) {
+        munmap(const_cast<std::byte *>(data), size);
+        throw std::runtime_error("catalog " + path + " is invalid or outdated");
+    }
+
+    source_hash = header->source_hash;
+    auto strings = section<char>(header->strings);
+    tables = {section<format::Item>(header->items),
+              section<format::Recipe>(header->recipes),
+              section<format::Factory>(header->factories),
+              section<format::Technology>(header->technologies),
+              section<format::Amount>(header->amounts),
+              section<format::Str>(header->names),
+              {strings.data(), strings.size()}};
+    if (!slices_fit(tables)) {
+        munmap(const_cast<std::byte *>(data), size);
+        throw std::runtime_error("catalog " + path + " is invalid or outdated");
+    }
+}
+
+Catalog::~Catalog() {
+    if (data) {
+        munmap(const_cast<std::byte *>(data), size);
+    }
+}
+
+template <class T>
+std::span<const T> Catalog::section(const format::Section &s) const {
+    return {reinterpret_cast<const T *>(data + s.offset), s.count};
+}
+
+std::string_view Catalog::str(const format::Str &s) const {
+    return {tables.strings.data() + s.offset, s.length};
+}
+
+AmountList Catalog::amounts(const format::Range &r) const {
+    return {*this, tables.amounts.subspan(r.begin, r.count)};
+}
+
+NameList Catalog::names(const format::Range &r) const {
+    return {*this, tables.names.subspan(r.begin, r.count)};
+}
+
+ItemTable Catalog::items() const { return {*this, tables.items}; }
+
+RecipeTable Catalog::recipes() const { return {*this, tables.recipes}; }
+
+FactoryTable Catalog::factories() const { return {*this, tables.factories}; }
+
+TechnologyTable Catalog::technologies() const {
+    return {*this, tables.technologies};
+}
+
+namespace {
+
+std::string to_str(std::string_view s) {
+    return std::string(s);
+}
+
+ItemList to_item_list(const AmountList &l) {
+    ItemList list;
+    for (AmountView a : l) {
+        list.emplace_back(to_str(a.get_name()), a.get_amount());
+    }
+    return list;
+}
+
+template <class Container>
+Container to_names(const NameList &l) {
+    Container c;
+    for (NameView n : l) {
+        c.insert(c.end(), to_str(n.get_name()));
+    }
+    return c;
+}
+
+}  // namespace
+
+Entities Catalog::to_entities() const {
+    Entities e;
+    auto &[items, recipes, factories, technologies] = e;
+
+    for (ItemView i : this->items()) {
+        items.emplace(std::piecewise_construct,
+                      std::forward_as_tuple(i.get_name()),
+                      std::forward_as_tuple(to_str(i.get_name()),
+                                            to_str(i.get_type())));
+    }
+    for (RecipeView r : this->recipes()) {
+        recipes.emplace(
+            std::piecewise_construct, std::forward_as_tuple(r.get_name()),
+            std::forward_as_tuple(to_str(r.get_name()),
+                                  to_str(r.get_category()),
+                                  r.get_required_energy(), r.is_enabled(),
+                                  to_item_list(r.get_ingredients()),
+                                  to_item_list(r.get_products())));
+    }
+    for (FactoryView f : this->factories()) {
+        factories.emplace(
+            std::piecewise_construct, std::forward_as_tuple(f.get_name()),
+            std::forward_as_tuple(
+                to_str(f.get_name()), f.get_crafting_speed(),
+                to_names<std::unordered_set<std::string>>(
+                    f.get_crafting_categories())));
+    }
+    for (TechnologyView t : this->technologies()) {
+        technologies.emplace(
+            std::piecewise_construct, std::forward_as_tuple(t.get_name()),
+            std::forward_as_tuple(
+                to_str(t.get_name()),
+                to_names<std::vector<std::string>>(t.get_prerequisites()),
+                to_item_list(t.get_ingredients()),
+                to_names<std::vector<std::string>>(t.get_unlocked_recipes())));
+    }
+    return e;
+}
+
+std::string_view AmountView::get_name() const { return c->str(a->name); }
+std::string_view NameView::get_name() const { return c->str(*s); }
+std::string_view ItemView::get_name() const { return c->str(i->name); }
+std::string_view ItemView::get_type() const { return c->str(i->type); }
+
+std::string_view RecipeView::get_name() const { return c->str(r->name); }
+std::string_view RecipeView::get_category() const {
+    return c->str(r->category);
+}
+AmountList RecipeView::get_ingredients() const {
+    return c->amounts(r->ingredients);
+}
+AmountList RecipeView::get_products() const { return c->amounts(r->products); }
+
+std::string_view FactoryView::get_name() const { return c->str(f->name); }
+NameList FactoryView::get_crafting_categories() const {
+    return c->names(f->crafting_categories);
+}
+
+std::string_view TechnologyView::get_name() const { return c->str(t->name); }
+NameList TechnologyView::get_prerequisites() const {
+    return c->names(t->prerequisites);
+}
+AmountList TechnologyView::get_ingredients() const {
+    return c->amounts(t->ingredients);
+}
+NameList TechnologyView::get_unlocked_recipes() const {
+    return c->names(t->unlocked_recipes);
+}
+
+}  // namespace catalog
@@ -0,0 +1,86 @@
+#include "cost.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace {
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+}  // namespace
+
+// The cost of an item is the minimum over its recipes, and the cost of a
+// recipe is a sum over its ingredients. Recipes may form cycles, so instead of
+// a plain recursion, items are finalized in order of increasing cost (as in
+// Dijkstra's algorithm): a recipe is evaluated as soon as the costs of all of
+// its ingredients are final. Thus, a recipe never contributes to the cost of
+// its own ingredients, and cycles are not exploited.
+CostModel::CostModel(const RecipeMap &all_recipes, const EntityIndex &index) {
+    using Entry = std::pair<double, std::string>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::unordered_map<const Recipe *, std::size_t> missing;
+
+    // Offer the products of r, whose ingredients are all final.
+    auto evaluate = [&](const Recipe &r) {
+        double cost = recipe_costs.at(&r);
+        for (const auto &[name, amount] : r.get_products()) {
+            double per_unit = cost / amount;
+            auto [it, inserted] = item_costs.try_emplace(name, infinity);
+            if (per_unit < it->second) {
+                it->second = per_unit;
+                queue.push({per_unit, name});
+            }
+        }
+    };
+
+    for (const auto &[_, r] : all_recipes) {
+        double speed = 0;
+        for (const Factory *f : index.get_factories(r.get_category())) {
+            speed = std::max(speed, f->get_crafting_speed());
+        }
+        recipe_costs[&r] = speed > 0 ? r.get_required_energy() / speed
+                                     : infinity;
+        missing[&r] = r.get_ingredients().size();
+    }
+    for (const auto &[_, r] : all_recipes) {
+        if (missing[&r] == 0) {
+            evaluate(r);
+        }
+    }
+
+    std::unordered_map<std::string, bool> done;
+    while (!queue.empty()) {
+        auto [cost, name] = queue.top();
+        queue.pop();
+        if (done[name]) {
+            continue;
+        }
+        done[name] = true;
+
+        for (const Recipe *r : index.get_consumers(name)) {
+            recipe_costs[r] += r->get_ingredients().at(name) * cost;
+            if (--missing[r] == 0) {
+                evaluate(*r);
+            }
+        }
+    }
+
+    // Recipes with an ingredient that cannot be produced.
+    for (auto &[r, cost] : recipe_costs) {
+        if (missing[r] > 0) {
+            cost = infinity;
+        }
+    }
+}
+
+double CostModel::get_item_cost(const std::string &item) const {
+    auto search = item_costs.find(item);
+    return search == item_costs.end() ? infinity : search->second;
+}
+
+double CostModel::get_recipe_cost(const Recipe &r,
+                                  const std::string &product) const {
+    return recipe_costs.at(&r) / r.get_products().at(product);
+}
@@ -1,11 +1,184 @@
 #include "entity.hpp"
 
+#include <cmath>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 
 #include "util.hpp"
 
-void Recipe::set_energy(const Factory &f) {
-    remaining_energy = f.calc_ticks(*this);
+EntityIndex::EntityIndex(const RecipeMap &all_recipes,
+                         const FactoryMap &all_factories,
+                         const TechnologyMap &all_technologies)
+    : technology_tree(all_technologies) {
+    auto add_item = [&](const std::string &name) {
+        if (item_ids.try_emplace(name, item_ids.size()).second) {
+            item_names.push_back(name);
+        }
+    };
+
+    for (const auto &[_, r] : all_recipes) {
+        for (const auto &[name, _] : r.get_products()) {
+            producers[name].push_back(&r);
+            add_item(name);
+        }
+        for (const auto &[name, _] : r.get_ingredients()) {
+            consumers[name].push_back(&r);
+            add_item(name);
+        }
+    }
+    for (const auto &[name, f] : all_factories) {
+        for (const std::string &category : f.get_crafting_categories()) {
+            factories[category].push_back(&f);
+        }
+        add_item(name);
+    }
+    for (const auto &[_, t] : all_technologies) {
+        for (const std::string &name : t.get_unlocked_recipes()) {
+            // If multiple technologies unlock a recipe, use the first one.
+            unlocked_by.try_emplace(&all_recipes.at(name), &t);
+        }
+        for (const auto &[name, _] : t.get_ingredients()) {
+            add_item(name);
+        }
+    }
+}
+
+int calc_execution_times(const Recipe &r, const std::string &product_name,
+                         int product_amount) {
+    int recipe_amount = r.get_products().at(product_name);
+    return std::ceil(static_cast<double>(product_amount) / recipe_amount);
+}
+
+int calc_ingredient_amount(const Recipe &r, const std::string &product_name,
+                           int product_amount,
+                           const std::string &ingredient_name) {
+    int execution_amount
+        = calc_execution_times(r, product_name, product_amount);
+    int produced_amount = r.get_ingredients().at(ingredient_name);
+    return execution_amount * produced_amount;
+}
+
+TechnologyTree::TechnologyTree(const TechnologyMap &all_technologies) {
+    // Assign ids in depth-first post-order, which is topological.
+    enum class Mark { none, active, done };
+    std::unordered_map<const Technology *, Mark> marks;
+    auto assign = [&](auto &self, const Technology &t) -> void {
+        Mark &mark = marks[&t];
+        if (mark == Mark::done) {
+            return;
+        }
+        if (mark == Mark::active) {
+            throw std::invalid_argument("technology prerequisites form a cycle"
+                                        " at " + t.get_name());
+        }
+        mark = Mark::active;
+        for (const std::string &s : t.get_prerequisites()) {
+            self(self, all_technologies.at(s));
+        }
+        mark = Mark::done;
+        ids[&t] = technologies.size();
+        technologies.push_back(&t);
+    };
+    for (const auto &[_, t] : all_technologies) {
+        assign(assign, t);
+    }
+
+    // Prerequisites have smaller ids, so their closures are complete.
+    closures.resize(size(), TechnologySet(size()));
+    total_costs.resize(size());
+    for (std::size_t id = 0; id < size(); ++id) {
+        TechnologySet &closure = closures[id];
+        closure[id] = true;
+        for (const std::string &s : technologies[id]->get_prerequisites()) {
+            const TechnologySet &other = get_closure(all_technologies.at(s));
+            for (std::size_t i = 0; i < id; ++i) {
+                if (other[i]) {
+                    closure[i] = true;
+                }
+            }
+        }
+        for (std::size_t i = 0; i <= id; ++i) {
+            if (closure[i]) {
+                for (const auto &[name, amount] :
+                     technologies[i]->get_ingredients()) {
+                    total_costs[id][name] += amount;
+                }
+            }
+        }
+    }
+
+    // The same traversal as a recursive research would do, starting at every
+    // technology.
+    research_orders.resize(size());
+    for (std::size_t id = 0; id < size(); ++id) {
+        TechnologySet visited(size());
+        TechnologyList &order = research_orders[id];
+        auto visit = [&](auto &self, const Technology &t) -> void {
+            int i = ids.at(&t);
+            if (visited[i]) {
+                return;
+            }
+            visited[i] = true;
+            for (const std::string &s : t.get_prerequisites()) {
+                self(self, all_technologies.at(s));
+            }
+            order.push_back(&t);
+        };
+        visit(visit, *technologies[id]);
+    }
+
+    for (const Technology *t : technologies) {
+        for (const std::string &r : t->get_unlocked_recipes()) {
+            unlocked_by[r].push_back(t);
+        }
+    }
+}
+
+TechnologyTree::TechnologyList TechnologyTree::get_missing(
+    const Technology &t, const TechnologySet &unlocked) const {
+    TechnologyList missing;
+    for (const Technology *p : get_research_order(t)) {
+        if (!unlocked[get_id(*p)]) {
+            missing.push_back(p);
+        }
+    }
+    return missing;
+}
+
+ItemCount TechnologyTree::get_cost(const Technology &t,
+                                   const TechnologySet &unlocked) const {
+    ItemCount cost;
+    const TechnologySet &closure = get_closure(t);
+    for (std::size_t i = 0; i < size(); ++i) {
+        if (closure[i] && !unlocked[i]) {
+            for (const auto &[name, amount] :
+                 technologies[i]->get_ingredients()) {
+                cost[name] += amount;
+            }
+        }
+    }
+    return cost;
+}
+
+TechnologyTree::TechnologyList TechnologyTree::get_research_sequence(
+    const Recipe &r, const TechnologySet &unlocked) const {
+    if (r.is_enabled()) {
+        return {};
+    }
+    auto search = unlocked_by.find(r.get_name());
+    if (search == unlocked_by.end()) {
+        throw std::invalid_argument("no technology unlocks "
+                                    + r.get_name());
+    }
+    std::optional<TechnologyList> best;
+    for (const Technology *t : search->second) {
+        TechnologyList missing = get_missing(*t, unlocked);
+        if (!best || missing.size() < best->size()) {
+            best = std::move(missing);
+        }
+    }
+    return *best;
 }
 
 std::string Item::to_string() const {
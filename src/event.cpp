@@ -1,41 +1,144 @@
 #include "event.hpp"
 
+#include <concepts>
 #include <sstream>
 
 #include "util.hpp"
 
+long get_timestamp(const AnyEvent &e) {
+    return std::visit([](const Event &e) { return e.get_timestamp(); }, e);
+}
+
+FactoryIdMap::fid_t get_factory_id(const AnyEvent &e) {
+    return std::visit([]<class E>(const E &e) -> FactoryIdMap::fid_t {
+        if constexpr (std::derived_from<E, FactoryEvent>) {
+            return e.get_factory_id();
+        } else {
+            return 0;
+        }
+    }, e);
+}
+
+std::string_view get_type(const AnyEvent &e) {
+    return std::visit([](const auto &e) { return e.get_type(); }, e);
+}
+
+std::string to_string(const AnyEvent &e) {
+    return std::visit([](const auto &e) { return e.to_string(); }, e);
+}
+
+std::ostream &operator<<(std::ostream &os, const AnyEvent &e) {
+    return os << to_string(e);
+}
+
+void to_json(nlohmann::json &j, const AnyEvent &e) {
+    std::visit([&](const auto &e) { to_json(j, e); }, e);
+}
+
 void to_json(nlohmann::json &j, const EventList &l) {
     for (const auto &e : l) {
-        j.push_back(e->as_json());
+        j.push_back(e);
     }
 }
 
-std::string Event::to_string() const {
+AnyEvent event_from_json(const nlohmann::json &j, const RecipeMap &recipes,
+                         const FactoryMap &factories,
+                         const TechnologyMap &technologies) {
+    auto type = j.at("type").get<std::string>();
+    long timestamp = j.at("timestamp").get<long>();
+    auto fid = [&] { return j.at("factory-id").get<FactoryIdMap::fid_t>(); };
+    auto str = [&](const char *key) { return j.at(key).get<std::string>(); };
+    auto find = [&](const auto &map, const char *key) -> const auto & {
+        auto search = map.find(str(key));
+        if (search == map.end()) {
+            throw std::invalid_argument("unknown " + std::string(key) + ": "
+                                        + str(key));
+        }
+        return search->second;
+    };
+
+    if (type == ResearchEvent::type) {
+        return ResearchEvent(timestamp, find(technologies, "technology"));
+    } else if (type == BuildEvent::type) {
+        return BuildEvent(timestamp, find(factories, "factory-type"), fid());
+    } else if (type == DestroyEvent::type) {
+        return DestroyEvent(timestamp, fid());
+    } else if (type == StartEvent::type) {
+        return StartEvent(timestamp, fid(), find(recipes, "recipe"));
+    } else if (type == StopEvent::type) {
+        return StopEvent(timestamp, fid());
+    } else if (type == VictoryEvent::type) {
+        return VictoryEvent(timestamp);
+    }
+    throw std::invalid_argument("unknown event type: " + type);
+}
+
+std::string Event::to_string(std::string_view type) const {
     std::ostringstream ss;
-    ss << timestamp << ": " << get_type();
+    ss << timestamp << ": " << type;
     return ss.str();
 }
 
 std::string ResearchEvent::to_string() const {
     std::ostringstream ss;
-    ss << Event::to_string() << " for " << technology;
+    ss << Event::to_string(type) << " for " << technology->get_name();
     return ss.str();
 }
 
-std::string FactoryEvent::to_string() const {
+std::string FactoryEvent::to_string(std::string_view type) const {
     std::ostringstream ss;
-    ss << Event::to_string() << " for factory " << factory_id;
+    ss << Event::to_string(type) << " for factory " << factory_id;
     return ss.str();
 }
 
 std::string BuildEvent::to_string() const {
     std::ostringstream ss;
-    ss << FactoryEvent::to_string() << " (" << factory_type << ")";
+    ss << FactoryEvent::to_string(type) << " (" << factory->get_name() << ")";
     return ss.str();
 }
 
 std::string StartEvent::to_string() const {
     std::ostringstream ss;
-    ss << FactoryEvent::to_string() << " (building " << recipe << ")";
+    ss << FactoryEvent::to_string(type) << " (building " << recipe->get_name()
+       << ")";
     return ss.str();
 }
+
+void EventWriter::push(const AnyEvent &e) {
+    os << (empty ? '[' : ',') << nlohmann::json(e);
+    empty = false;
+}
+
+void EventWriter::close() {
+    if (empty) {
+        os << '[';
+    }
+    os << ']';
+}
+
+std::optional<AnyEvent> EventReader::next() {
+    if (done) {
+        return std::nullopt;
+    }
+
+    // Elements are preceded by '[' (the first one) or ',' (all others).
+    char c = 0;
+    is >> c;
+    if (c != (started ? ',' : '[') && !(started && c == ']')) {
+        throw std::invalid_argument("malformed event list");
+    }
+    if (!started) {
+        started = true;
+        if ((is >> std::ws).peek() == ']') {
+            c = is.get();
+        }
+    }
+    if (c == ']') {
+        done = true;
+        return std::nullopt;
+    }
+
+    nlohmann::json j;
+    is >> j;
+    return event_from_json(j, recipes, factories, technologies);
+}
@@ -1,15 +1,65 @@
 #include "game.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <utility>
 
 #include "event.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 
 namespace game {
 
 using fid_t = FactoryIdMap::fid_t;
 
-State::State(const RecipeMap &all_recipes) {
+namespace {
+
+// Order in which events are executed: by timestamp, then by kind (in the order
+// of the steps in Simulation::advance), then by technology or factory id.
+bool executes_before(const AnyEvent &a, const AnyEvent &b) {
+    auto ka = std::pair(get_timestamp(a), a.index());
+    auto kb = std::pair(get_timestamp(b), b.index());
+    if (ka != kb) {
+        return ka < kb;
+    }
+    if (const auto *r = std::get_if<ResearchEvent>(&a)) {
+        return r->get_technology().get_name()
+             < std::get<ResearchEvent>(b).get_technology().get_name();
+    }
+    return get_factory_id(a) < get_factory_id(b);
+}
+
+// The events of one kind, which form a contiguous range within a tick.
+template <class E>
+auto events_of(std::span<const AnyEvent> events) {
+    auto is_e = [](const AnyEvent &e) { return std::holds_alternative<E>(e); };
+    auto first = std::ranges::find_if(events, is_e);
+    auto last = std::find_if_not(first, events.end(), is_e);
+    return std::ranges::subrange(first, last)
+         | std::views::transform(
+               [](const AnyEvent &e) -> const E & { return std::get<E>(e); });
+}
+
+}  // namespace
+
+void to_json(nlohmann::json &j, const Violation &v) {
+    j = nlohmann::json{{"tick", v.tick}, {"message", v.message}};
+    if (v.event) {
+        j["event"] = *v.event;
+    }
+    if (!v.item.empty()) {
+        j["item"] = v.item;
+    }
+}
+
+State::State(const RecipeMap &all_recipes,
+             std::pmr::memory_resource *resource)
+    : items(resource),
+      unlocked_recipes(resource),
+      unlocked_technologies(resource) {
     for (const auto &[_, r] : all_recipes) {
         if (r.is_enabled()) {
             unlocked_recipes.insert(&r);
@@ -36,9 +86,13 @@ bool State::has_items(const ItemCount &list) const {
 
 void State::add_item(const std::string &name, int amount) {
     //std::clog << "adding " << amount << "x " << name << std::endl;
-    items[name] += amount;
-    if (items[name] < 0) {
-        throw std::invalid_argument("item amount must not be < 0");
+    auto it = items.find(name);
+    if (it == items.end()) {
+        it = items.emplace(name, 0).first;
+    }
+    it->second += amount;
+    if (it->second < 0) {
+        throw InventoryError(name);
     }
 }
 
@@ -75,46 +129,244 @@ void State::unlock_technology(const Technology &technology,
     }
 }
 
+void Simulation::fail(std::string message, const AnyEvent *event,
+                      std::string item) const {
+    Violation v{tick, std::nullopt, std::move(item), std::move(message)};
+    if (event) {
+        v.event = *event;
+    }
+    throw SimulationError(std::move(v));
+}
+
+template <class E, class F>
+void Simulation::execute(const E &e, F &&f) {
+    try {
+        f();
+    } catch (const SimulationError &) {
+        throw;
+    } catch (const InventoryError &error) {
+        AnyEvent event = e;
+        fail(error.what(), &event, error.get_item());
+    } catch (const std::exception &error) {
+        AnyEvent event = e;
+        fail(error.what(), &event);
+    }
+}
+
+int Simulation::get_recipe_id(const Recipe &r) {
+    auto [it, inserted] = recipe_ids.try_emplace(&r, recipe_table.size());
+    if (inserted) {
+        recipe_table.push_back(&r);
+    }
+    return it->second;
+}
+
+void Simulation::add_starved(slot_t slot) {
+    slots.status[slot] = Status::starved;
+    ready.push_back({slot, ++slots.wait_id[slot]});
+}
+
+void Simulation::remove_starved(slot_t slot) {
+    slots.status[slot] = Status::idle;
+    ++slots.wait_id[slot];
+}
+
+bool Simulation::is_waiting(const Waiter &w) const {
+    return slots.status[w.slot] == Status::starved
+        && slots.wait_id[w.slot] == w.id;
+}
+
+void Simulation::wake(const std::string &name) {
+    auto search = waiting.find(name);
+    if (search == waiting.end()) {
+        return;
+    }
+    for (const Waiter &w : search->second) {
+        if (is_waiting(w)) {
+            ready.push_back(w);
+        }
+    }
+    search->second.clear();
+}
+
+void Simulation::add_item(const std::string &name) {
+    state.add_item(name);
+    wake(name);
+}
+
+void Simulation::add_items(const ItemCount &list) {
+    for (const auto &[name, amount] : list) {
+        state.add_item(name, amount);
+        wake(name);
+    }
+}
+
 void Simulation::cancel_recipe(fid_t fid) {
-    auto search = active_factories.find(fid);
-    if (search != active_factories.end()) {
-        state.add_items(search->second.get_ingredients());
-        active_factories.erase(search);
+    auto search = slot_of.find(fid);
+    if (search == slot_of.end()) {
+        return;
+    }
+    slot_t slot = search->second;
+    switch (slots.status[slot]) {
+    case Status::active:
+        // The corresponding entry in completions is skipped in next_tick.
+        add_items(recipe_table[slots.recipe[slot]]->get_ingredients());
+        slots.status[slot] = Status::idle;
+        break;
+    case Status::starved:
+        // In case the factory finished its recipe in the current tick.
+        remove_starved(slot);
+        break;
+    default:
+        break;
     }
-    // In case the factory finished its recipe in the current tick.
-    starved_factories.erase(fid);
 }
 
-void Simulation::build_factory(const BuildEvent *e, bool consume) {
-    const Factory &f = all_factories.at(e->get_factory_type());
+void Simulation::build_factory(const BuildEvent &e, bool consume) {
+    const Factory &f = e.get_factory();
     if (consume) {
         state.remove_item(f.get_name());
     }
     //std::clog << "building " << f << std::endl;
-    factory_id_map.insert(&f, e->get_factory_id());
+    fid_t fid = factory_id_map.insert(&f, e.get_factory_id());
+    slot_of[fid] = slots.add(fid, &f);
 }
 
-long Simulation::simulate() {
-    auto victory
-        = std::ranges::find(events, VictoryEvent::type, &Event::get_type);
+void Simulation::destroy_factory(fid_t fid) {
+    cancel_recipe(fid);
+    add_item(factory_id_map.erase(fid)->get_name());
+    slots.status[slot_of.at(fid)] = Status::destroyed;
+    slot_of.erase(fid);
+}
+
+void Simulation::start_recipe(fid_t fid, const Recipe &r) {
+    auto search = slot_of.find(fid);
+    if (search == slot_of.end()) {
+        throw std::logic_error("factory does not exist");
+    }
+    cancel_recipe(fid);
+    slot_t slot = search->second;
+    slots.recipe[slot] = get_recipe_id(r);
+    add_starved(slot);  // Gather for step 10.
+}
+
+std::optional<AnyEvent> Simulation::next_from_source() {
+    try {
+        return source->next();
+    } catch (const std::invalid_argument &error) {
+        // E.g., an event with an unknown recipe.
+        fail(error.what());
+    }
+}
+
+void Simulation::fetch() {
+    lookahead.reset();
+    if (!source) {
+        // With checkpoints, the events are kept for resimulate to diff.
+        if (next_event < events.size()) {
+            if (checkpoint_interval > 0) {
+                lookahead = events[next_event++];
+            } else {
+                lookahead = std::move(events[next_event++]);
+            }
+        }
+        return;
+    }
+
+    while (auto e = next_from_source()) {
+        long timestamp = get_timestamp(*e);
+        if (timestamp < source_tick) {
+            fail("event out of order: " + to_string(*e), &*e);
+        }
+        source_tick = timestamp;
+        if (!std::holds_alternative<VictoryEvent>(*e)) {
+            lookahead = std::move(e);
+            return;
+        }
+        if (!victory_tick) {
+            victory_tick = timestamp;
+        }
+    }
+}
+
+void Simulation::gather_events() {
+    tick_events.clear();
+    while (lookahead && get_timestamp(*lookahead) == tick) {
+        tick_events.push_back(std::move(*lookahead));
+        fetch();
+    }
+    if (source) {
+        std::ranges::stable_sort(tick_events, executes_before);
+    }
+    FBOO_COUNT_N(events, tick_events.size());
+}
+
+void Simulation::add_initial_items() {
+    for (const auto &[name, amount] : initial_items) {
+        state.add_item(name, amount);
+    }
+}
+
+void Simulation::prepare_events() {
+    auto victory = std::ranges::find_if(events, [](const AnyEvent &e) {
+        return std::holds_alternative<VictoryEvent>(e);
+    });
     if (victory == events.end()) {
-        throw std::logic_error("no VictoryEvent found in EventList");
+        fail("no VictoryEvent found in EventList");
     }
-    long victory_tick = victory->get()->get_timestamp();
+    victory_tick = get_timestamp(*victory);
     events.erase(victory);
 
-    std::ranges::sort(events, {}, &Event::get_timestamp);
+    std::ranges::stable_sort(events, executes_before);
+}
+
+void Simulation::initialize() {
+    fetch();
 
     // Initialization: execute all (Build)Events with the initial timestamp.
     //std::clog << "tick -1: initializing factories" << std::endl;
-    while (!events.empty() && events.front()->get_timestamp() == tick) {
-        build_factory(dynamic_cast<const BuildEvent *>(events.front().get()),
-                      false);
-        events.pop_front();
+    gather_events();
+    for (const AnyEvent &e : tick_events) {
+        const auto *b = std::get_if<BuildEvent>(&e);
+        if (!b) {
+            fail("only BuildEvents may happen initially", &e);
+        }
+        execute(*b, [&] { build_factory(*b, false); });
     }
+}
+
+long Simulation::simulate() {
+    FBOO_TIME(simulate_ns);
+    if (!source) {
+        prepare_events();
+    }
+    return start();
+}
 
-    while (tick < victory_tick) {
+long Simulation::start() {
+    initialize();
+    if (!source && checkpoint_interval > 0) {
+        save_checkpoint();
+    }
+    return run();
+}
+
+long Simulation::run() {
+    // A source only reveals the victory tick once it reaches it.
+    while (!victory_tick || tick < *victory_tick) {
+        if (!victory_tick && !lookahead) {
+            fail("no VictoryEvent found in EventSource");
+        }
         advance();
+        if (goal_items) {
+            if (auto deadlock = find_deadlock()) {
+                throw SimulationError(std::move(*deadlock));
+            }
+        }
+        if (!source && checkpoint_interval > 0
+            && tick - checkpoints.back().tick >= checkpoint_interval) {
+            save_checkpoint();
+        }
 
         //std::clog << "items after tick " << tick << ": " << state.get_items()
         //          << std::endl << std::endl;
@@ -122,122 +374,306 @@ long Simulation::simulate() {
 
     //std::clog << "done in tick " << tick << ", items: " << state.get_items()
     //          << std::endl;
+    if (goal_items) {
+        for (const auto &[name, amount] : *goal_items) {
+            if (state.has_item(name) < amount) {
+                AnyEvent victory = VictoryEvent(tick);
+                fail("goal item missing", &victory, name);
+            }
+        }
+    }
     return tick;
 }
 
+std::optional<Violation> Simulation::validate(const ItemCount &goal_items) {
+    this->goal_items = &goal_items;
+    std::optional<Violation> violation;
+    try {
+        simulate();
+    } catch (const SimulationError &e) {
+        violation = e.get_violation();
+    }
+    this->goal_items = nullptr;
+    return violation;
+}
+
+std::optional<Violation> Simulation::find_deadlock() {
+    // Anything may still happen if an event or a recipe is pending.
+    if (lookahead) {
+        return std::nullopt;
+    }
+    while (!completions.empty() && !is_pending(completions.top())) {
+        completions.pop();
+    }
+    if (!completions.empty()) {
+        return std::nullopt;
+    }
+
+    // Nothing changes until the victory tick anymore.
+    auto missing_goal = std::ranges::find_if(*goal_items, [&](const auto &p) {
+        return state.has_item(p.first) < p.second;
+    });
+    if (missing_goal == goal_items->end()) {
+        return std::nullopt;
+    }
+    // The starved factory with the lowest id, which step 10 checks first.
+    std::optional<slot_t> lowest;
+    for (slot_t s = 0; s < slots.fid.size(); ++s) {
+        if (slots.status[s] == Status::starved
+            && (!lowest || slots.fid[s] < slots.fid[*lowest])) {
+            lowest = s;
+        }
+    }
+    if (lowest) {
+        slot_t slot = *lowest;
+        for (const auto &[name, amount] :
+             recipe_table[slots.recipe[slot]]->get_ingredients()) {
+            if (state.has_item(name) < amount) {
+                return Violation{tick, std::nullopt, name,
+                                 "deadlock: factory "
+                                     + std::to_string(slots.fid[slot])
+                                     + " waits for an ingredient"};
+            }
+        }
+    }
+    return Violation{tick, std::nullopt, missing_goal->first,
+                     "deadlock: goal item can no longer be produced"};
+}
+
+void Simulation::save_checkpoint() {
+    // All events up to the current tick were gathered, only the lookahead
+    // was not.
+    std::size_t next = next_event - lookahead.has_value();
+    checkpoints.push_back({tick, next, state, slots, slot_of, waiting, ready,
+                           completions, factory_id_map});
+}
+
+void Simulation::restore_checkpoint(const Checkpoint &c) {
+    tick = c.tick;
+    next_event = c.next_event;
+    state = c.state;
+    slots = c.slots;
+    slot_of = c.slot_of;
+    waiting = c.waiting;
+    ready = c.ready;
+    completions = c.completions;
+    factory_id_map = c.factory_id_map;
+    tick_events.clear();
+    fetch();
+}
+
+long Simulation::resimulate(EventList new_events) {
+    FBOO_TIME(simulate_ns);
+    if (source) {
+        throw std::logic_error("an EventSource cannot be resimulated");
+    }
+    EventList old_events = std::exchange(events, std::move(new_events));
+    prepare_events();
+
+    // Checkpoints are taken after a tick was executed completely, so they are
+    // only valid if all events up to their tick are unchanged. Checkpoints
+    // after the new victory tick are useless. Without checkpoints, the old
+    // events were moved out by fetch and cannot be diffed.
+    if (!checkpoints.empty()) {
+        auto [old_diff, new_diff] = std::ranges::mismatch(old_events, events);
+        long changed = std::numeric_limits<long>::max();
+        if (old_diff != old_events.end()) {
+            changed = get_timestamp(*old_diff);
+        }
+        if (new_diff != events.end()) {
+            changed = std::min(changed, get_timestamp(*new_diff));
+        }
+        std::erase_if(checkpoints, [&](const Checkpoint &c) {
+            return c.tick >= changed || c.tick > *victory_tick;
+        });
+    }
+
+    if (!checkpoints.empty()) {
+        FBOO_COUNT(checkpoint_restored);
+        restore_checkpoint(checkpoints.back());
+        return run();
+    }
+
+    // Start from scratch.
+    tick = BuildEvent::initial;
+    next_event = 0;
+    state = State(all_recipes, resource);
+    add_initial_items();
+    slots = FactorySlots(resource);
+    slot_of.clear();
+    waiting.clear();
+    ready.clear();
+    completions = CompletionQueue(resource);
+    factory_id_map = FactoryIdMap();
+    return start();
+}
+
+bool Simulation::is_pending(const Completion &c) const {
+    const auto &[finish_tick, slot] = c;
+    return slots.status[slot] == Status::active
+        && slots.finish_tick[slot] == finish_tick;
+}
+
+long Simulation::next_tick() const {
+    // Until a source reaches the VictoryEvent, the next event is bounded by
+    // the lookahead.
+    long next = victory_tick.value_or(std::numeric_limits<long>::max());
+    // Events with a timestamp in the past are never executed, just like in a
+    // tick-by-tick simulation.
+    if (lookahead && get_timestamp(*lookahead) > tick) {
+        next = std::min(next, get_timestamp(*lookahead));
+    }
+    if (!completions.empty()) {
+        next = std::min(next, completions.top().first);
+    }
+    // Make sure we always make progress.
+    return std::max(next, tick + 1);
+}
+
 void Simulation::advance() {
-    // Step 1: increment timestamp.
-    if (++tick > (1ll << 40)) {
-        throw std::logic_error("game duration exceeded 2^40, aborting");
-    }
-
-    // Step 2: gather, group and sort events for the current tick.
-    std::vector<const Event *> cur_events;
-    while (!events.empty() && events.front()->get_timestamp() == tick) {
-        cur_events.push_back(events.front().get());
-        events.pop_front();
-    }
-    //std::clog << "tick " << tick << ", cur_events: " << cur_events << std::endl;
-    std::vector<const ResearchEvent *> research_events;
-    std::vector<const FactoryEvent *> other_events;
-    if (!cur_events.empty()) {
-        auto mid = std::partition(cur_events.begin(), cur_events.end(),
-                                  cast_event<ResearchEvent>);
-        std::transform(cur_events.begin(), mid,
-                       std::back_inserter(research_events),
-                       cast_event<ResearchEvent>);
-        // The VictoryEvent is removed in simulate, so casting the remaining
-        // events to FactoryEvent is safe.
-        std::transform(mid, cur_events.end(), std::back_inserter(other_events),
-                       cast_event<FactoryEvent>);
-
-        std::ranges::sort(research_events, {}, &ResearchEvent::get_technology);
-        std::ranges::sort(other_events, {}, &FactoryEvent::get_factory_id);
-    }
-
-    // Step 3: work on (or finish) recipes.
-    for (auto it = active_factories.begin(); it != active_factories.end(); ) {
-        auto &[fid, r] = *it;
-        //std::clog << "factory " << fid << ": ";
-        if (r.tick() == 0) {
-            //std::clog << "finished " << r << std::endl;
-            state.add_items(r.get_products());
-            starved_factories.insert({fid, r});  // Gather for step 10.
-            it = active_factories.erase(it);
-        } else {
-            //std::clog << "working " << r << std::endl;
-            ++it;
+    FBOO_COUNT(advance);
+    FBOO_STEP_TIMER(timer);
+    // Drop completions of recipes that were cancelled in the meantime.
+    while (!completions.empty() && !is_pending(completions.top())) {
+        completions.pop();
+    }
+
+    // Step 1: increment timestamp. All ticks up to the next event or finished
+    // recipe are idle: no items are added, so starved factories stay starved.
+    tick = next_tick();
+    if (tick > (1ll << 40)) {
+        fail("game duration exceeded 2^40, aborting");
+    }
+    FBOO_STEP(timer, tick);
+
+    // Step 2: gather the events for the current tick, grouped by kind and
+    // sorted by technology or factory id.
+    gather_events();
+    std::span<const AnyEvent> cur_events(tick_events);
+    //std::clog << "tick " << tick << ", cur_events: " << tick_events << std::endl;
+    FBOO_STEP(timer, gather);
+
+    // Step 3: finish recipes. All other active factories keep working.
+    while (!completions.empty() && completions.top().first == tick) {
+        Completion c = completions.top();
+        completions.pop();
+        if (!is_pending(c)) {
+            continue;  // Cancelled in the meantime.
         }
+
+        slot_t slot = c.second;
+        //std::clog << "factory " << slots.fid[slot] << ": finished "
+        //          << recipe_table[slots.recipe[slot]] << std::endl;
+        add_items(recipe_table[slots.recipe[slot]]->get_products());
+        add_starved(slot);  // Gather for step 10.
+        FBOO_COUNT(recipes_finished);
     }
+    FBOO_STEP(timer, finish);
 
     // Step 4: execute research events.
-    for (const ResearchEvent *e : research_events) {
-        const Technology &technology = all_technologies.at(e->get_technology());
-        for (const std::string &prerequisite : technology.get_prerequisites()) {
-            if (!state.is_unlocked(all_technologies.at(prerequisite))) {
-                throw std::logic_error("prerequisite not yet unlocked");
+    for (const ResearchEvent &e : events_of<ResearchEvent>(cur_events)) {
+        execute(e, [&] {
+            const Technology &technology = e.get_technology();
+            for (const std::string &prerequisite :
+                 technology.get_prerequisites()) {
+                if (!state.is_unlocked(all_technologies.at(prerequisite))) {
+                    AnyEvent event = e;
+                    fail("prerequisite not yet unlocked", &event,
+                         prerequisite);
+                }
             }
-        }
 
-        //std::clog << "unlocking " << technology << std::endl;
-        state.unlock_technology(technology, all_recipes);
+            //std::clog << "unlocking " << technology << std::endl;
+            state.unlock_technology(technology, all_recipes);
+        });
     }
+    FBOO_STEP(timer, research);
 
     // Step 5: execute stop factory events.
-    for (const StopEvent *e : extract_subclass<StopEvent>(other_events)) {
-        fid_t fid = e->get_factory_id();
+    for (const StopEvent &e : events_of<StopEvent>(cur_events)) {
+        fid_t fid = e.get_factory_id();
         //std::clog << "factory " << fid << ": stopping" << std::endl;
-        cancel_recipe(fid);
+        execute(e, [&] { cancel_recipe(fid); });
     }
+    FBOO_STEP(timer, stop);
 
     // Step 6: execute destroy factory events.
-    for (const DestroyEvent *e : extract_subclass<DestroyEvent>(other_events)) {
-        fid_t fid = e->get_factory_id();
+    for (const DestroyEvent &e : events_of<DestroyEvent>(cur_events)) {
+        fid_t fid = e.get_factory_id();
         //std::clog << "factory " << fid << ": destroying" << std::endl;
-        cancel_recipe(fid);
-        state.add_item(factory_id_map.erase(fid)->get_name());
+        execute(e, [&] { destroy_factory(fid); });
     }
+    FBOO_STEP(timer, destroy);
 
     // Step 7: handle victory event. This is handled in simulate via the
     // while-condition. Executing the remaining steps in the victory-tick is
     // more or less irrelevant.
+    FBOO_STEP(timer, victory);
 
     // Step 8: handle build factory events.
-    for (const BuildEvent *e : extract_subclass<BuildEvent>(other_events)) {
-        build_factory(e);
+    for (const BuildEvent &e : events_of<BuildEvent>(cur_events)) {
+        execute(e, [&] { build_factory(e); });
     }
+    FBOO_STEP(timer, build);
 
     // Step 9: execute start factory events.
-    for (const StartEvent *e : extract_subclass<StartEvent>(other_events)) {
-        fid_t fid = e->get_factory_id();
-        cancel_recipe(fid);
-
-        if (!state.is_unlocked(all_recipes.at(e->get_recipe()))) {
-            throw std::logic_error("recipe not yet unlocked");
-        }
-        // std::clog << "factory " << fid << ": commencing " << r << std::endl;
-        // Gather for step 10. Use insert_or_assign to potentially overwrite a
-        // recipe that was inserted for fid in step 3.
-        starved_factories.insert_or_assign(fid,
-                                           all_recipes.at(e->get_recipe()));
+    for (const StartEvent &e : events_of<StartEvent>(cur_events)) {
+        execute(e, [&] {
+            const Recipe &r = e.get_recipe();
+            if (!state.is_unlocked(r)) {
+                AnyEvent event = e;
+                fail("recipe not yet unlocked", &event, r.get_name());
+            }
+            // std::clog << "factory " << fid << ": commencing " << r
+            //           << std::endl;
+            // This potentially overwrites a recipe that was gathered in
+            // step 3.
+            start_recipe(e.get_factory_id(), r);
+        });
     }
+    FBOO_STEP(timer, start);
 
     // Step 10: handle starved factories by starting production if possible.
-    for (auto it = starved_factories.begin(); it != starved_factories.end(); ) {
-        auto [fid, r] = *it;  // Copy r, its energy is reset below.
-        const ItemCount &ings = r.get_ingredients();
-        if (state.has_items(ings)) {
+    // Only the factories that became starved or got the ingredient they
+    // waited for can start, all others still lack it (items were only removed
+    // in the meantime). They are checked in order of their factory ids.
+    std::ranges::sort(ready, {}, [&](const Waiter &w) {
+        return slots.fid[w.slot];
+    });
+    FBOO_COUNT_N(starved_checks, ready.size());
+    for (const Waiter &w : ready) {
+        if (!is_waiting(w)) {
+            continue;
+        }
+        slot_t slot = w.slot;
+        const Recipe *r = recipe_table[slots.recipe[slot]];
+        const ItemCount &ings = r->get_ingredients();
+        auto missing = std::ranges::find_if(ings, [&](const auto &ing) {
+            return state.has_item(ing.first) < ing.second;
+        });
+        if (missing == ings.end()) {
             state.remove_items(ings);
-            // r.energy is 0, so we need to set the energy before starting.
-            r.set_energy(*factory_id_map[fid]);
-            //std::clog << "factory " << fid << ": starting " << r << std::endl;
-            active_factories.insert({fid, r});
-
-            it = starved_factories.erase(it);
+            long finish_tick = tick + slots.factory[slot]->calc_ticks(*r);
+            //std::clog << "factory " << slots.fid[slot] << ": starting " << r
+            //          << std::endl;
+            slots.status[slot] = Status::active;
+            slots.finish_tick[slot] = finish_tick;
+            completions.push({finish_tick, slot});
+            FBOO_COUNT(recipes_started);
         } else {
-            ++it;
+            auto it = waiting.find(missing->first);
+            if (it == waiting.end()) {
+                it = waiting
+                         .emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(missing->first),
+                                  std::forward_as_tuple())
+                         .first;
+            }
+            it->second.push_back(w);
         }
     }
+    ready.clear();
+    FBOO_STEP(timer, starved);
 }
 
 }  // namespace game
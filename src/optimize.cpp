@@ -0,0 +1,320 @@
+#include "optimize.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "stats.hpp"
+
+namespace {
+
+using fid_t = FactoryIdMap::fid_t;
+using Clock = std::chrono::steady_clock;
+
+long uniform(std::mt19937_64 &rng, long lo, long hi) {
+    return lo + static_cast<long>(rng() % (hi - lo + 1));
+}
+
+// A recipe that is executed on a factory from a StartEvent until the next
+// StopEvent of that factory.
+struct Run {
+    std::size_t start, stop;  // Indices into the plan.
+    long earliest;  // Of the previous event of the factory, or its build.
+};
+
+// The factories that are built by the initial events or the plan. Moves do not
+// change BuildEvents, so this is the same for all candidates.
+struct Built {
+    const Factory *factory;
+    long tick;
+};
+using BuiltMap = std::map<fid_t, Built>;
+
+BuiltMap collect_built(const EventList &events) {
+    BuiltMap built;
+    for (const AnyEvent &e : events) {
+        if (const auto *b = std::get_if<BuildEvent>(&e)) {
+            built[b->get_factory_id()] = {&b->get_factory(),
+                                          b->get_timestamp()};
+        }
+    }
+    return built;
+}
+
+std::vector<Run> find_runs(const EventList &plan, const BuiltMap &built) {
+    // StartEvents and StopEvents of every factory, in execution order.
+    std::map<fid_t, std::vector<std::size_t>> by_factory;
+    for (std::size_t i = 0; i < plan.size(); ++i) {
+        if (std::holds_alternative<StartEvent>(plan[i])
+            || std::holds_alternative<StopEvent>(plan[i])) {
+            by_factory[get_factory_id(plan[i])].push_back(i);
+        }
+    }
+
+    std::vector<Run> runs;
+    for (auto &[fid, indices] : by_factory) {
+        std::ranges::sort(indices, {}, [&](std::size_t i) {
+            return std::pair(get_timestamp(plan[i]), plan[i].index());
+        });
+        auto b = built.find(fid);
+        long earliest = b == built.end() ? 0 : std::max(0l, b->second.tick);
+        for (std::size_t k = 0; k < indices.size(); ++k) {
+            std::size_t i = indices[k];
+            if (std::holds_alternative<StartEvent>(plan[i])
+                && k + 1 < indices.size()
+                && std::holds_alternative<StopEvent>(plan[indices[k + 1]])) {
+                runs.push_back({i, indices[k + 1], earliest});
+            }
+            earliest = get_timestamp(plan[i]);
+        }
+    }
+    return runs;
+}
+
+// Move a run to an earlier tick, keeping its duration. Runs that end last are
+// preferred, since only they determine the victory tick.
+bool start_earlier(EventList &plan, const std::vector<Run> &runs,
+                   std::mt19937_64 &rng) {
+    long last = 0;
+    std::vector<const Run *> critical;
+    for (const Run &r : runs) {
+        long stop = get_timestamp(plan[r.stop]);
+        if (stop > last) {
+            last = stop;
+            critical.clear();
+        }
+        if (stop == last) {
+            critical.push_back(&r);
+        }
+    }
+    const Run &r = critical.empty() || rng() % 2
+                     ? runs[uniform(rng, 0, runs.size() - 1)]
+                     : *critical[uniform(rng, 0, critical.size() - 1)];
+
+    const auto &start = std::get<StartEvent>(plan[r.start]);
+    long from = start.get_timestamp();
+    if (from <= r.earliest) {
+        return false;
+    }
+    // Either as early as possible, or by a random amount.
+    long slack = from - r.earliest;
+    long shift = rng() % 2 ? slack : uniform(rng, 1, slack);
+    plan[r.start] = StartEvent(from - shift, start.get_factory_id(),
+                               start.get_recipe());
+    plan[r.stop] = StopEvent(get_timestamp(plan[r.stop]) - shift,
+                             start.get_factory_id());
+    return true;
+}
+
+// Whether factory fid executes a run between the ticks from and stop. A run
+// may stop at from or start at stop, since stopping executes first.
+bool is_busy(const EventList &plan, const std::vector<Run> &runs, fid_t fid,
+             long from, long stop) {
+    return std::ranges::any_of(runs, [&](const Run &r) {
+        return get_factory_id(plan[r.start]) == fid
+            && get_timestamp(plan[r.start]) < stop
+            && from < get_timestamp(plan[r.stop]);
+    });
+}
+
+// Execute a run on another idle factory that can craft its recipe, for the
+// same number of executions.
+bool swap_factory(EventList &plan, const std::vector<Run> &runs,
+                  const BuiltMap &built, std::mt19937_64 &rng) {
+    const Run &r = runs[uniform(rng, 0, runs.size() - 1)];
+    const auto &start = std::get<StartEvent>(plan[r.start]);
+    long from = start.get_timestamp();
+    const Recipe &recipe = start.get_recipe();
+    auto current = built.find(start.get_factory_id());
+    if (current == built.end()) {
+        return false;
+    }
+
+    long old_ticks = current->second.factory->calc_ticks(recipe);
+    long executions
+        = (get_timestamp(plan[r.stop]) - from + old_ticks - 1) / old_ticks;
+    std::vector<std::pair<fid_t, long>> options;  // With their stop tick.
+    for (const auto &[fid, b] : built) {
+        if (fid == current->first || b.tick > from
+            || !b.factory->get_crafting_categories().contains(
+                recipe.get_category())) {
+            continue;
+        }
+        long stop = from + executions * b.factory->calc_ticks(recipe);
+        if (!is_busy(plan, runs, fid, from, stop)) {
+            options.emplace_back(fid, stop);
+        }
+    }
+    if (options.empty()) {
+        return false;
+    }
+    auto [fid, stop] = options[uniform(rng, 0, options.size() - 1)];
+
+    plan[r.start] = StartEvent(from, fid, recipe);
+    plan[r.stop] = StopEvent(stop, fid);
+    return true;
+}
+
+bool research_earlier(EventList &plan, std::mt19937_64 &rng) {
+    std::vector<std::size_t> research;
+    for (std::size_t i = 0; i < plan.size(); ++i) {
+        if (std::holds_alternative<ResearchEvent>(plan[i])
+            && get_timestamp(plan[i]) > 0) {
+            research.push_back(i);
+        }
+    }
+    if (research.empty()) {
+        return false;
+    }
+
+    AnyEvent &e = plan[research[uniform(rng, 0, research.size() - 1)]];
+    const auto &r = std::get<ResearchEvent>(e);
+    e = ResearchEvent(uniform(rng, 0, r.get_timestamp() - 1),
+                      r.get_technology());
+    return true;
+}
+
+}  // namespace
+
+PlanOptimizer::PlanOptimizer(const RecipeMap &all_recipes,
+                             const FactoryMap &all_factories,
+                             const TechnologyMap &all_technologies,
+                             EventList initial_events,
+                             const ItemList &initial_items,
+                             const ItemList &goal_items)
+    : all_recipes(all_recipes),
+      all_factories(all_factories),
+      all_technologies(all_technologies),
+      initial_events(std::move(initial_events)),
+      initial_items(initial_items) {
+    for (const auto &[name, amount] : goal_items) {
+        this->goal_items[name] += amount;
+    }
+}
+
+std::optional<long> PlanOptimizer::evaluate(game::Simulation &sim,
+                                            const EventList &plan) const {
+    FBOO_COUNT(optimize_candidate);
+    EventList events = initial_events;
+    long victory = 0;
+    for (const AnyEvent &e : plan) {
+        events.push_back(e);
+        victory = std::max(victory, get_timestamp(e));
+    }
+    events.push_back(VictoryEvent(victory));
+
+    try {
+        long tick = sim.resimulate(std::move(events));
+        if (sim.get_state().has_items(goal_items)) {
+            return tick;
+        }
+    } catch (const std::exception &) {
+        // The candidate is invalid.
+    }
+    return std::nullopt;
+}
+
+EventList PlanOptimizer::optimize(EventList plan,
+                                  const Options &options) const {
+    const auto deadline = Clock::now() + options.budget;
+    const EventList original = plan;
+    std::erase_if(plan, [](const AnyEvent &e) {
+        return std::holds_alternative<VictoryEvent>(e);
+    });
+
+    auto make_simulation = [&] {
+        return game::Simulation(all_recipes, all_factories, all_technologies,
+                                EventList(), initial_items);
+    };
+    game::Simulation check = make_simulation();
+    std::optional<long> base = evaluate(check, plan);
+    if (!base) {
+        return original;
+    }
+
+    EventList all_events = initial_events;
+    std::ranges::copy(plan, std::back_inserter(all_events));
+    const BuiltMap built = collect_built(all_events);
+    // About 64 checkpoints per simulation.
+    const long interval = std::max(1l, *base / 64);
+
+    // Every worker climbs on its own, starting from the best plan found by
+    // any worker whenever that one improves. Candidates that are as fast as
+    // the current plan are accepted to escape plateaus.
+    std::mutex mutex;
+    EventList best = plan;
+    long best_tick = *base;
+    long version = 0;
+
+    auto worker = [&](unsigned id) {
+        std::mt19937_64 rng(options.seed + id);
+        game::Simulation sim = make_simulation();
+        sim.set_checkpoint_interval(interval);
+        EventList current;
+        long current_tick = 0, current_version = -1;
+
+        while (Clock::now() < deadline) {
+            {
+                std::lock_guard lock(mutex);
+                if (current_version != version) {
+                    current = best;
+                    current_tick = best_tick;
+                    current_version = version;
+                }
+            }
+
+            EventList candidate = current;
+            std::vector<Run> runs = find_runs(candidate, built);
+            bool moved = false;
+            switch (rng() % 3) {
+            case 0:
+                moved = !runs.empty() && start_earlier(candidate, runs, rng);
+                break;
+            case 1:
+                moved = !runs.empty()
+                     && swap_factory(candidate, runs, built, rng);
+                break;
+            default:
+                moved = research_earlier(candidate, rng);
+                break;
+            }
+            if (!moved) {
+                continue;
+            }
+
+            std::optional<long> tick = evaluate(sim, candidate);
+            if (!tick || *tick > current_tick) {
+                continue;
+            }
+            current = std::move(candidate);
+            current_tick = *tick;
+
+            std::lock_guard lock(mutex);
+            if (current_tick < best_tick) {
+                FBOO_COUNT(optimize_improvement);
+                best = current;
+                best_tick = current_tick;
+                current_version = ++version;
+            }
+        }
+    };
+
+    unsigned jobs = options.jobs;
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::jthread> pool;
+    for (unsigned i = 1; i < jobs; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    worker(0);
+    pool.clear();  // Join.
+
+    std::ranges::stable_sort(best, {}, get_timestamp);
+    best.push_back(VictoryEvent(best_tick));
+    return best;
+}
@@ -1,8 +1,10 @@
 #include "order.hpp"
 
 #include <iostream>
+#include <optional>
 
 #include "game.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 
 using fid_t = FactoryIdMap::fid_t;
@@ -11,11 +13,23 @@ bool Order::is_factory_available(const Recipe &r) {
     return craftable_categories.contains(r.get_category());
 }
 
+void Order::emit(AnyEvent e) {
+    //std::clog << "emit: " << e << std::endl;
+    if (schedule == Schedule::concurrent) {
+        order.push_back(std::move(e));  // Sorted in compute.
+        return;
+    }
+    last_timestamp = get_timestamp(e);
+    sink->push(e);
+}
+
 fid_t Order::add_factory(const Factory &f, fid_t fid) {
-    //std::clog << "add_factory: " << order.back() << std::endl;
     for (const std::string &s : f.get_crafting_categories()) {
-        craftable_categories.insert(s);
+        if (!craftable_categories.contains(s)) {
+            craftable_categories.emplace(s);
+        }
     }
+    invalidate_infeasible();
 
     fid_map.insert(&f, fid);
     return fid;
@@ -27,28 +41,113 @@ FactoryIdMap::fid_t Order::add_factory(const Factory &f) {
 
     // BuildEvents are handled before StartEvents, so we don't need to
     // increment tick here.
-    order.push_back(std::make_shared<BuildEvent>(tick, f, fid));
+    long build_tick = tick;
+    if (schedule == Schedule::concurrent) {
+        build_tick = ready_tick(f.get_name());
+        factory_free_tick[fid] = build_tick;
+    }
+    emit(BuildEvent(build_tick, f, fid));
     return fid;
 }
 
 void Order::add_technology(const Technology &t) {
     state.unlock_technology(t, all_recipes);
-    order.push_back(std::make_shared<ResearchEvent>(tick, t.get_name()));
-    //std::clog << "add_technology: " << order.back() << std::endl;
+    invalidate_infeasible();
+
+    long research = tick;
+    if (schedule == Schedule::concurrent) {
+        research = ready_tick(t.get_ingredients());
+        // ResearchEvents of the same tick are executed in alphabetical order,
+        // so research prerequisites at least one tick earlier.
+        for (const std::string &s : t.get_prerequisites()) {
+            auto search = research_tick.find(&all_technologies.at(s));
+            if (search != research_tick.end()) {
+                research = std::max(research, search->second + 1);
+            }
+        }
+        research_tick[&t] = research;
+        for (const std::string &s : t.get_unlocked_recipes()) {
+            recipe_unlock_tick[&all_recipes.at(s)] = research;
+        }
+    }
+    emit(ResearchEvent(research, t));
 }
 
-void Order::add_recipe(const Recipe &r, int amount) {
+long Order::ready_tick(const std::string &item) const {
+    int id = index.get_item_id(item);
+    return id < 0 ? 0 : item_ready_tick[id];
+}
+
+long Order::ready_tick(const ItemCount &items) const {
+    long ready = 0;
+    for (const auto &[name, _] : items) {
+        ready = std::max(ready, ready_tick(name));
+    }
+    return ready;
+}
+
+void Order::schedule_serial(const Recipe &r, int amount) {
     auto f = std::ranges::find_if(fid_map, [&](const auto &v) {
         return v.second->get_crafting_categories().contains(r.get_category());
     });
     if (f == fid_map.end()) {
         throw std::logic_error("no factory exists for this recipe");
     }
-    order.push_back(std::make_shared<StartEvent>(tick, f->first, r));
-    //std::clog << "craft: " << order.back() << ", ";
+    emit(StartEvent(tick, f->first, r));
     tick += f->second->calc_ticks(r) * amount;
-    order.push_back(std::make_shared<StopEvent>(tick, f->first));
-    //std::clog << order.back() << std::endl;
+    emit(StopEvent(tick, f->first));
+}
+
+// A recipe may start as soon as its technology is researched and all of its
+// ingredients that were planned before are produced. Items only become
+// available once the recipe producing them is stopped, and every recipe
+// waits for all previously planned productions of its ingredients. Since
+// the inventory always suffices for the recipes in planning order, no
+// factory ever starves.
+void Order::schedule_concurrent(const Recipe &r, int amount) {
+    long ready = ready_tick(r.get_ingredients());
+    if (auto search = recipe_unlock_tick.find(&r);
+        search != recipe_unlock_tick.end()) {
+        ready = std::max(ready, search->second);
+    }
+
+    // Use the factory that finishes first, ties are broken by factory id.
+    std::optional<fid_t> best;
+    long best_start = 0, best_finish = 0;
+    for (const auto &[fid, f] : fid_map) {
+        if (!f->get_crafting_categories().contains(r.get_category())) {
+            continue;
+        }
+        auto free = factory_free_tick.find(fid);
+        long start = std::max(
+            ready, free == factory_free_tick.end() ? 0 : free->second);
+        long finish = start + f->calc_ticks(r) * amount;
+        if (!best || finish < best_finish
+            || (finish == best_finish && fid < *best)) {
+            best = fid;
+            best_start = start;
+            best_finish = finish;
+        }
+    }
+    if (!best) {
+        throw std::logic_error("no factory exists for this recipe");
+    }
+
+    emit(StartEvent(best_start, *best, r));
+    emit(StopEvent(best_finish, *best));
+    factory_free_tick[*best] = best_finish;
+    for (const auto &[iname, _] : r.get_products()) {
+        long &ready = item_ready_tick[index.get_item_id(iname)];
+        ready = std::max(ready, best_finish);
+    }
+}
+
+void Order::add_recipe(const Recipe &r, int amount) {
+    if (schedule == Schedule::concurrent) {
+        schedule_concurrent(r, amount);
+    } else {
+        schedule_serial(r, amount);
+    }
 
     // Update inventory.
     for (const auto &[iname, iamount] : r.get_ingredients()) {
@@ -57,46 +156,44 @@ void Order::add_recipe(const Recipe &r, int amount) {
     for (const auto &[iname, iamount] : r.get_products()) {
         state.add_item(iname, iamount * amount);
     }
+    invalidate_infeasible();
 }
 
-namespace {
-// How many times does r need to be executed to produce product_name
-// product_amount many times?
-int calc_execution_times(const Recipe &r, const std::string &product_name,
-                          int product_amount) {
-    int recipe_amount = r.get_products().at(product_name);
-    return std::ceil(static_cast<double>(product_amount) / recipe_amount);
-}
-
-// How many ingredient_name need to be created in order to produce product_name
-// product_amount many times using r?
-int calc_ingredient_amount(const Recipe &r, const std::string &product_name,
-                           int product_amount,
-                           const std::string &ingredient_name) {
-    int execution_amount
-        = calc_execution_times(r, product_name, product_amount);
-    int produced_amount = r.get_ingredients().at(ingredient_name);
-    return execution_amount * produced_amount;
+void Order::set_creatable(const std::string &name, const Recipe &r) {
+    const Recipe *&memo = creatable_items[index.get_item_id(name)];
+    if (memo != &r) {
+        memo = &r;
+        invalidate_infeasible();
+    }
 }
-}  // namespace
 
 bool Order::craft_recipe(const Recipe &r, const std::string &name, int amount,
-                         std::set<std::string> visited, bool dry_run) {
-    if (state.is_unlocked(r) || create_technology(r, visited, dry_run)) {
+                         bool dry_run) {
+    FBOO_COUNT(craft_recipe);
+    if (dry_run) {
+        FBOO_COUNT(dry_run);
+    }
+    long start_cycle_cuts = cycle_cuts;
+    if (state.is_unlocked(r) || create_technology(r, dry_run)) {
         if (is_factory_available(r)
-            || create_factory(r.get_category(), visited, dry_run)) {
+            || create_factory(r.get_category(), dry_run)) {
             // (Try to) create all ingredients.
             if (std::ranges::all_of(
                     r.get_ingredients(), [&](const Ingredient &i) {
                         return create_item(i.get_name(),
                                            calc_ingredient_amount(
                                                r, name, amount, i.get_name()),
-                                           visited, dry_run);
+                                           dry_run);
                     })) {
                 if (!dry_run) {
                     add_recipe(r, calc_execution_times(r, name, amount));
                 }
-                creatable_items[name] = &r;
+                // If a cycle was cut, r only works on the current path.
+                // Memoizing it could make a later, real run of r recurse
+                // into itself.
+                if (cycle_cuts == start_cycle_cuts) {
+                    set_creatable(name, r);
+                }
                 return true;
             }
         }
@@ -104,16 +201,18 @@ bool Order::craft_recipe(const Recipe &r, const std::string &name, int amount,
     return false;
 }
 
-bool Order::create_item(const std::string &name, int amount,
-                        std::set<std::string> visited, bool dry_run) {
+bool Order::create_item(const std::string &name, int amount, bool dry_run) {
+    FBOO_COUNT(create_item);
     int have = state.has_item(name);
     //std::clog << "working on " << amount << " of " << name << " (" << have
     //          << " available)" << (dry_run ? " DRY" : "") << std::endl;
 
-    if (creatable_items.contains(name)) {
+    int id = index.get_item_id(name);
+    if (id >= 0 && creatable_items[id]) {
         //std::clog << name << " is known to be creatable" << std::endl;
+        FBOO_COUNT(memo_hit);
         if (!dry_run) {
-            craft_recipe(*creatable_items[name], name, amount, visited, false);
+            craft_recipe(*creatable_items[id], name, amount, false);
         }
         return true;
     }
@@ -123,47 +222,73 @@ bool Order::create_item(const std::string &name, int amount,
         return true;
     }
 
+    // Items without an id are not produced by any recipe.
+    if (id < 0) {
+        return false;
+    }
     // Avoid dependency-cycles (i.e., an item depends on itself).
-    if (visited.contains(name)) {
+    if (visited[id]) {
+        ++cycle_cuts;
+        FBOO_COUNT(cycle_cut);
         return false;
     }
-    visited.insert(name);
-
-    auto options
-        = all_recipes | std::views::values
-          | std::views::filter([&](const Recipe &r) {
-                return r.get_products().contains(name);
-            })
-          | std::views::transform([](const Recipe &r) { return &r; });
-    std::vector<const Recipe *> better_options(options.begin(), options.end());
-    std::ranges::sort(better_options, {}, [&](const Recipe *r) {
-        // TODO opt: I don't think this makes sense, but it improves results...
-        return is_factory_available(*r);
-    });
+    Infeasible &known = infeasible[id];
+    if (known.generation == generation && amount >= known.amount) {
+        //std::clog << name << " is known to be infeasible" << std::endl;
+        FBOO_COUNT(infeasible_hit);
+        return false;
+    }
+    long start_generation = generation;
+    long start_cycle_cuts = cycle_cuts;
+
+    const EntityIndex::RecipeList &options = index.get_producers(name);
+    std::pmr::vector<const Recipe *> better_options(options.begin(),
+                                                    options.end(), resource);
+    if (costs) {
+        std::ranges::stable_sort(better_options, {}, [&](const Recipe *r) {
+            return costs->get_recipe_cost(*r, name);
+        });
+    } else {
+        std::ranges::sort(better_options, {}, [&](const Recipe *r) {
+            // TODO opt: I don't think this makes sense, but it improves
+            // results...
+            return is_factory_available(*r);
+        });
+    }
 
+    visited[id] = true;
+    bool created = false;
     for (const Recipe *r : better_options) {
         // std::clog << "trying " << r << std::endl;
-        if (craft_recipe(*r, name, amount, visited, true)) {
+        if (craft_recipe(*r, name, amount, true)) {
             if (!dry_run) {
-                craft_recipe(*r, name, amount, visited, false);
+                craft_recipe(*r, name, amount, false);
             }
-            return true;
+            created = true;
+            break;
         }
     }
+    visited[id] = false;
 
-    return false;
+    // Only remember the failure if it neither depends on the path nor on
+    // changes of the state made while exploring.
+    if (!created && generation == start_generation
+        && cycle_cuts == start_cycle_cuts) {
+        known = {generation, amount};
+    }
+    return created;
 }
 
-bool Order::create_factory(const std::string &category,
-                           std::set<std::string> visited, bool dry_run) {
+bool Order::create_factory(const std::string &category, bool dry_run) {
+    FBOO_COUNT(create_factory);
     //std::clog << "working on factory for " << category
     //          << (dry_run ? " DRY" : "") << std::endl;
-    for (const auto &[fname, f] : all_factories) {
-        if (f.get_crafting_categories().contains(category)
-            && all_recipes.contains(fname)  // Skip player.
-            && create_item(fname, 1, visited, dry_run)) {
+    for (const Factory *f : index.get_factories(category)) {
+        const std::string &fname = f->get_name();
+        if (all_recipes.contains(fname)  // Skip player.
+            && create_item(fname, 1, dry_run)) {
             if (!dry_run) {
-                add_factory(f);
+                add_factory(*f);
             }
             return true;
         }
@@ -171,75 +296,77 @@ bool Order::create_factory(const std::string &category,
     return false;
 }
 
-bool Order::create_technology(const Recipe &r, std::set<std::string> visited,
-                              bool dry_run) {
+bool Order::create_technology(const Recipe &r, bool dry_run) {
     //std::clog << "working on technology for " << r << (dry_run ? " DRY" : "")
     //          << std::endl;
-    auto tmp = std::ranges::find_if(all_technologies, [&](const auto &t) {
-        return t.second.get_unlocked_recipes().contains(r.get_name());
-    });
-    if (tmp == all_technologies.end()) {
+    const Technology *tmp = index.get_unlocking_technology(r);
+    if (!tmp) {
         throw std::logic_error("no technology found for this recipe");
     }
 
-    const Technology &t = tmp->second;
-    //std::clog << "trying " << t << std::endl;
-    if (!create_technology(t, visited, true)) {
-        return false;
-    }
-    //std::clog << t << " works for " << r << std::endl;
-    if (!dry_run) {
-        create_technology(t, visited, false);
-    }
-    return true;
+    //std::clog << "trying " << *tmp << std::endl;
+    return create_technology(*tmp, dry_run);
 }
 
-bool Order::create_technology(const Technology &t,
-                              std::set<std::string> visited, bool dry_run) {
+bool Order::create_technology(const Technology &t, bool dry_run) {
+    FBOO_COUNT(create_technology);
     if (state.is_unlocked(t)) {
         return true;
     }
 
-    // Check if all prerequisites can be (or already are) researched, and if all
-    // ingredients can be created. Only if everything works, we actually create
-    // the technology.
-    auto descend_prerequisites = [&](bool dry_run) {
-        return std::ranges::all_of(
-            t.get_prerequisites(), [&](const std::string &s) {
-                return create_technology(all_technologies.at(s), visited,
-                                         dry_run);
-            });
-    };
-    if (!descend_prerequisites(true)) {
-        return false;
+    // The prerequisites that are not researched yet (and t), each after its
+    // own prerequisites. Only if the ingredients of all of them can be
+    // created, we actually create the technologies.
+    std::pmr::vector<const Technology *> missing(resource);
+    for (const Technology *p :
+         index.get_technology_tree().get_research_order(t)) {
+        if (!state.is_unlocked(*p)) {
+            missing.push_back(p);
+        }
     }
 
-    auto descend_ingredients = [&](bool dry_run) {
+    auto descend_ingredients = [&](const Technology *p, bool dry_run) {
         return std::ranges::all_of(
-            t.get_ingredients(), [&](const Ingredient &i) {
-                return create_item(i.get_name(), i.get_amount(), visited,
-                                   dry_run);
+            p->get_ingredients(), [&](const Ingredient &i) {
+                return create_item(i.get_name(), i.get_amount(), dry_run);
             });
     };
-    if (!descend_ingredients(true)) {
+    if (!std::ranges::all_of(missing, [&](const Technology *p) {
+            return descend_ingredients(p, true);
+        })) {
         return false;
     }
 
     if (!dry_run) {
-        descend_prerequisites(false);
-        descend_ingredients(false);
-        add_technology(t);
+        for (const Technology *p : missing) {
+            descend_ingredients(p, false);
+            add_technology(*p);
+        }
     }
     return true;
 }
 
-EventList Order::compute() {
+void Order::compute(EventSink &sink) {
+    FBOO_TIME(compute_ns);
+    this->sink = &sink;
     for (const auto &[name, amount] : goal_items) {
         create_item(name, amount);
     }
 
+    if (schedule == Schedule::concurrent) {
+        std::ranges::stable_sort(order, {}, get_timestamp);
+        for (const AnyEvent &e : order) {
+            last_timestamp = get_timestamp(e);
+            sink.push(e);
+        }
+        order.clear();
+    }
     // Victory is achieved in the same tick as the last event.
-    order.push_back(
-        std::make_shared<VictoryEvent>(order.back()->get_timestamp()));
-    return order;
+    sink.push(VictoryEvent(last_timestamp));
+}
+
+EventList Order::compute() {
+    EventCollector collector;
+    compute(collector);
+    return std::move(collector.events);
 }
@@ -0,0 +1,261 @@
+#include "rate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+constexpr double eps = 1e-9;
+
+// Minimize c*x subject to A*x >= b and x >= 0, where b >= 0, with the
+// two-phase simplex method on a dense tableau. Bland's rule prevents cycling.
+// Returns std::nullopt if there is no feasible solution.
+std::optional<std::vector<double>> minimize(
+    const std::vector<std::vector<double>> &A, const std::vector<double> &b,
+    const std::vector<double> &c) {
+    const std::size_t m = A.size(), n = c.size();
+    // Columns: n variables, m surplus variables, m artificial variables, and
+    // the right-hand side. Rows: m constraints and the objective.
+    const std::size_t cols = n + 2 * m + 1, rhs = cols - 1;
+    std::vector<std::vector<double>> t(m + 1, std::vector<double>(cols));
+    std::vector<std::size_t> basis(m);
+    for (std::size_t i = 0; i < m; ++i) {
+        std::ranges::copy(A[i], t[i].begin());
+        t[i][n + i] = -1;
+        t[i][n + m + i] = 1;
+        t[i][rhs] = b[i];
+        basis[i] = n + m + i;
+    }
+
+    auto pivot = [&](std::size_t row, std::size_t col) {
+        double p = t[row][col];
+        for (double &v : t[row]) {
+            v /= p;
+        }
+        for (std::size_t i = 0; i <= m; ++i) {
+            double f = t[i][col];
+            if (i == row || std::abs(f) < eps) {
+                continue;
+            }
+            for (std::size_t j = 0; j < cols; ++j) {
+                t[i][j] -= f * t[row][j];
+            }
+        }
+        basis[row] = col;
+    };
+
+    // Runs the simplex on the objective row (reduced costs, minimizing),
+    // only letting the first `allowed` columns enter the basis.
+    auto run = [&](std::size_t allowed) {
+        while (true) {
+            std::size_t col = allowed;
+            for (std::size_t j = 0; j < allowed; ++j) {
+                if (t[m][j] < -eps) {
+                    col = j;
+                    break;
+                }
+            }
+            if (col == allowed) {
+                return;  // Optimal.
+            }
+
+            std::size_t row = m;
+            double best = std::numeric_limits<double>::infinity();
+            for (std::size_t i = 0; i < m; ++i) {
+                if (t[i][col] > eps) {
+                    double ratio = t[i][rhs] / t[i][col];
+                    if (ratio < best - eps
+                        || (ratio < best + eps && basis[i] < basis[row])) {
+                        best = ratio;
+                        row = i;
+                    }
+                }
+            }
+            if (row == m) {
+                throw std::logic_error("rate problem is unbounded");
+            }
+            pivot(row, col);
+        }
+    };
+    // basis[m] is used as a sentinel for the ratio test.
+    basis.push_back(std::numeric_limits<std::size_t>::max());
+
+    // Phase 1: minimize the sum of the artificial variables.
+    std::ranges::fill(t[m], 0);
+    for (std::size_t i = 0; i < m; ++i) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            t[m][j] -= t[i][j];
+        }
+        t[m][n + m + i] = 0;
+    }
+    run(n + 2 * m);
+    if (-t[m][rhs] > 1e-6) {
+        return std::nullopt;
+    }
+    // Drive remaining (zero) artificial variables out of the basis, so they
+    // cannot become positive in phase 2. Rows where this is impossible are
+    // redundant.
+    for (std::size_t i = 0; i < m; ++i) {
+        if (basis[i] < n + m) {
+            continue;
+        }
+        for (std::size_t j = 0; j < n + m; ++j) {
+            if (std::abs(t[i][j]) > eps) {
+                pivot(i, j);
+                break;
+            }
+        }
+    }
+
+    // Phase 2: minimize the actual objective. Artificial variables that are
+    // still in the basis are 0 and may not enter again.
+    std::ranges::fill(t[m], 0);
+    std::ranges::copy(c, t[m].begin());
+    for (std::size_t i = 0; i < m; ++i) {
+        if (basis[i] < n && std::abs(t[m][basis[i]]) > 0) {
+            double f = t[m][basis[i]];
+            for (std::size_t j = 0; j < cols; ++j) {
+                t[m][j] -= f * t[i][j];
+            }
+        }
+    }
+    run(n + m);
+
+    std::vector<double> x(n);
+    for (std::size_t i = 0; i < m; ++i) {
+        if (basis[i] < n) {
+            x[basis[i]] = t[i][rhs];
+        }
+    }
+    return x;
+}
+
+}  // namespace
+
+const Factory *RateSolver::choose_factory(const Recipe &r) const {
+    const Factory *best = nullptr;
+    auto key = [&](const Factory *f) {
+        return std::pair(all_recipes.contains(f->get_name()),
+                         f->get_crafting_speed());
+    };
+    for (const Factory *f : index.get_factories(r.get_category())) {
+        if (!best || key(f) > key(best)) {
+            best = f;
+        }
+    }
+    return best;
+}
+
+RateSolver::Result RateSolver::solve(const RateMap &rates) const {
+    // Gather all items and recipes that can contribute to the requested items.
+    // Ordered maps keep the linear program (and thus the result)
+    // deterministic.
+    std::map<std::string, std::size_t> items;
+    std::map<std::string, const Recipe *> recipes;
+    std::vector<std::string> todo;
+    auto add_item = [&](const std::string &name) {
+        if (items.try_emplace(name, 0).second) {
+            todo.push_back(name);
+        }
+    };
+    for (const auto &[name, rate] : rates) {
+        if (rate < 0) {
+            throw std::invalid_argument("rate of " + name + " is negative");
+        }
+        add_item(name);
+    }
+    while (!todo.empty()) {
+        std::string name = std::move(todo.back());
+        todo.pop_back();
+        if (index.get_producers(name).empty()) {
+            throw std::invalid_argument("no recipe produces " + name);
+        }
+        for (const Recipe *r : index.get_producers(name)) {
+            if (!choose_factory(*r)
+                || !recipes.try_emplace(r->get_name(), r).second) {
+                continue;
+            }
+            for (const auto &[iname, _] : r->get_ingredients()) {
+                add_item(iname);
+            }
+            for (const auto &[iname, _] : r->get_products()) {
+                add_item(iname);
+            }
+        }
+    }
+
+    std::size_t row = 0;
+    for (auto &[_, i] : items) {
+        i = row++;
+    }
+
+    // One variable per recipe (executions per second), one constraint per
+    // item: its net production has to reach the requested rate.
+    std::vector<const Recipe *> columns;
+    std::vector<std::vector<double>> A(items.size());
+    std::vector<double> b(items.size()), c;
+    for (const auto &[_, r] : recipes) {
+        columns.push_back(r);
+        for (auto &a : A) {
+            a.push_back(0);
+        }
+        for (const auto &[iname, amount] : r->get_products()) {
+            A[items.at(iname)].back() += amount;
+        }
+        for (const auto &[iname, amount] : r->get_ingredients()) {
+            A[items.at(iname)].back() -= amount;
+        }
+        // Cost: the number of factories needed for one execution per second.
+        c.push_back(choose_factory(*r)->calc_ticks(*r) / ticks_per_second);
+    }
+    for (const auto &[name, rate] : rates) {
+        b[items.at(name)] = rate;
+    }
+
+    auto x = minimize(A, b, c);
+    if (!x) {
+        throw std::invalid_argument("requested rates cannot be produced");
+    }
+
+    Result result;
+    std::vector<double> net(items.size());
+    for (std::size_t j = 0; j < columns.size(); ++j) {
+        if ((*x)[j] < eps) {
+            continue;
+        }
+        const Recipe *r = columns[j];
+        result.recipes.push_back(
+            {r, choose_factory(*r), (*x)[j], (*x)[j] * c[j]});
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            net[i] += A[i][j] * (*x)[j];
+        }
+    }
+    for (const auto &[name, i] : items) {
+        if (net[i] - b[i] > 1e-6) {
+            result.surplus[name] = net[i] - b[i];
+        }
+    }
+    return result;
+}
+
+void to_json(nlohmann::json &j, const RateSolver::Result &r) {
+    j = nlohmann::json{{"recipes", nlohmann::json::array()},
+                       {"surplus", nlohmann::json::array()}};
+    for (const auto &rr : r.recipes) {
+        j["recipes"].push_back(
+            {{"recipe", rr.recipe->get_name()},
+             {"factory-type", rr.factory->get_name()},
+             {"executions-per-second", rr.executions},
+             {"factories", rr.factories},
+             {"factories-needed",
+              static_cast<long>(std::ceil(rr.factories - 1e-6))}});
+    }
+    for (const auto &[name, rate] : std::map(r.surplus.begin(),
+                                             r.surplus.end())) {
+        j["surplus"].push_back({{"name", name}, {"rate", rate}});
+    }
+}
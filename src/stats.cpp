@@ -0,0 +1,105 @@
+#include "stats.hpp"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+
+namespace stats {
+
+namespace {
+
+constexpr std::array<std::string_view, std::size_t(Step::count)> step_names
+    = {"tick",    "gather", "finish", "research", "stop",
+       "destroy", "victory", "build", "start",    "starved"};
+
+// Name of every counter in the report, and the group it is listed in.
+struct CounterName {
+    std::string_view group;
+    std::string_view name;
+};
+constexpr std::array<CounterName, std::size_t(Counter::count)> counter_names
+    = {{{"simulation", "ns"},
+        {"simulation", "advance"},
+        {"simulation", "events"},
+        {"simulation", "recipes-finished"},
+        {"simulation", "recipes-started"},
+        {"simulation", "starved-checks"},
+        {"simulation", "checkpoint-restored"},
+        {"order", "ns"},
+        {"order", "create-item"},
+        {"order", "craft-recipe"},
+        {"order", "dry-run"},
+        {"order", "memo-hit"},
+        {"order", "infeasible-hit"},
+        {"order", "cycle-cut"},
+        {"order", "create-factory"},
+        {"order", "create-technology"},
+        {"optimizer", "candidates"},
+        {"optimizer", "improvements"}}};
+
+#ifdef FBOO_STATS
+std::mutex total_mutex;
+Counters total;
+#endif
+
+}  // namespace
+
+#ifdef FBOO_STATS
+Counters &Counters::operator+=(const Counters &other) {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    for (std::size_t i = 0; i < step_calls.size(); ++i) {
+        step_calls[i] += other.step_calls[i];
+        step_ns[i] += other.step_ns[i];
+    }
+    return *this;
+}
+
+LocalCounters::~LocalCounters() {
+    std::lock_guard lock(total_mutex);
+    total += *this;
+}
+#endif
+
+void reset() {
+#ifdef FBOO_STATS
+    std::lock_guard lock(total_mutex);
+    total = Counters();
+    static_cast<Counters &>(local) = Counters();
+#endif
+}
+
+nlohmann::json report() {
+    std::array<long, std::size_t(Counter::count)> counts{};
+    std::array<long, std::size_t(Step::count)> step_calls{}, step_ns{};
+#ifdef FBOO_STATS
+    Counters sum;
+    {
+        std::lock_guard lock(total_mutex);
+        sum += total;
+    }
+    sum += local;
+    counts = sum.counts;
+    step_calls = sum.step_calls;
+    step_ns = sum.step_ns;
+#endif
+
+    nlohmann::json j;
+    j["enabled"] = enabled;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        const auto &[group, name] = counter_names[i];
+        j[group][name] = counts[i];
+    }
+    j["simulation"]["steps"] = nlohmann::json::array();
+    for (std::size_t i = 0; i < step_calls.size(); ++i) {
+        j["simulation"]["steps"].push_back({{"step", i + 1},
+                                            {"name", step_names[i]},
+                                            {"calls", step_calls[i]},
+                                            {"ns", step_ns[i]}});
+    }
+    return j;
+}
+
+}  // namespace stats